@@ -0,0 +1,250 @@
+// Implementation of the Channel Access beacon listener for ParseCASW
+
+// The beacons are received on EPICS_CA_REPEATER_PORT.  The socket
+// allows the port to be shared with a CA repeater for broadcast
+// beacons.  Each CA_PROTO_RSRV_IS_UP message gives the server address,
+// port, and beacon ID, and the time is when the datagram was received.
+// The period of each server's beacons is estimated the same way as by
+// bhe::updatePeriod in the CA client library, and only the beacons it
+// would report as anomalies are passed on, which is what casw prints.
+// The servers are found by interning their binary address and port in
+// a CNameTable, and the printable name is only made for a new server.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <envDefs.h>
+#include <caProto.h>
+
+#include "parsecasw.h"
+#include "utils.h"
+#include "CBeaconListener.h"
+
+// Size to request for the socket receive buffer so bursts of beacons
+// are not lost
+#define BEACON_RCVBUF_SIZE (4*1024*1024)
+// Initial size of the servers array, which doubles as needed
+#define BEACON_SERVERS_SIZE 256
+
+CBeaconListener::CBeaconListener(void) :
+    sock(INVALID_SOCKET),
+    attached(0),
+    serverPort(CA_SERVER_PORT),
+    servers(NULL),
+    serversSize(0),
+    buf(NULL),
+    cur(NULL),
+    end(NULL)
+{
+}
+
+CBeaconListener::~CBeaconListener(void)
+{
+    close();
+    for(int id=0; id < addrTable.count(); id++) delete servers[id];
+    if(servers) delete [] servers;
+}
+
+// Makes the socket.  Returns P_OK or P_ERROR.
+int CBeaconListener::open(void)
+{
+    char errString[256];
+    osiSockAddr addr;
+    int size=BEACON_RCVBUF_SIZE;
+
+    if(!osiSockAttach()) {
+	errMsg("Cannot attach to the socket library");
+	return P_ERROR;
+    }
+    attached=1;
+
+    sock=epicsSocketCreate(AF_INET,SOCK_DGRAM,IPPROTO_UDP);
+    if(sock == INVALID_SOCKET) {
+	epicsSocketConvertErrnoToString(errString,sizeof(errString));
+	errMsg("Cannot create beacon socket: %s",errString);
+	close();
+	return P_ERROR;
+    }
+    epicsSocketEnableAddressUseForDatagramFanout(sock);
+    setsockopt(sock,SOL_SOCKET,SO_RCVBUF,(char *)&size,sizeof(size));
+
+    memset(&addr,0,sizeof(addr));
+    addr.ia.sin_family=AF_INET;
+    addr.ia.sin_addr.s_addr=htonl(INADDR_ANY);
+    addr.ia.sin_port=htons(envGetInetPortConfigParam(&EPICS_CA_REPEATER_PORT,
+      (unsigned short)CA_REPEATER_PORT));
+    if(bind(sock,&addr.sa,sizeof(addr.ia)) < 0) {
+	epicsSocketConvertErrnoToString(errString,sizeof(errString));
+	errMsg("Cannot bind beacon socket to port %u: %s",
+	  ntohs(addr.ia.sin_port),errString);
+	close();
+	return P_ERROR;
+    }
+
+  // Servers before protocol 4.11 do not send their port
+    serverPort=envGetInetPortConfigParam(&EPICS_CA_SERVER_PORT,
+      (unsigned short)CA_SERVER_PORT);
+
+    buf=new char[MAX_UDP_RECV];
+    if(!buf) {
+	errMsg("Cannot allocate space for beacon buffer");
+	exit(1);
+    }
+    cur=end=buf;
+    programBeginTime=epicsTime::getCurrent();
+
+    return P_OK;
+}
+
+void CBeaconListener::close(void)
+{
+    if(sock != INVALID_SOCKET) epicsSocketDestroy(sock);
+    sock=INVALID_SOCKET;
+    if(attached) osiSockRelease();
+    attached=0;
+    if(buf) delete [] buf;
+    buf=NULL;
+    cur=end=NULL;
+}
+
+// Waits for the next anomaly.  The name is NUL terminated and hash is
+// its CNameTable::hash().  Returns P_OK, or P_ERROR if receiving fails.
+int CBeaconListener::getAnomaly(const char **pName, size_t *pNameLen,
+  unsigned *pHash, epicsTime *pTime)
+{
+    char errString[256];
+
+    while(1) {
+      // Look at the rest of the messages in the datagram
+	while(end-cur >= (int)sizeof(caHdr)) {
+	    caHdr hdr;
+	    memcpy(&hdr,cur,sizeof(hdr));
+	    cur+=sizeof(caHdr)+ntohs(hdr.m_postsize);
+	    if(ntohs(hdr.m_cmmd) != CA_PROTO_RSRV_IS_UP) continue;
+
+	    unsigned protocolRevision=ntohs(hdr.m_dataType);
+	    unsigned beaconNumber=ntohl(hdr.m_cid);
+	    struct sockaddr_in ina;
+	    memset(&ina,0,sizeof(ina));
+	    ina.sin_family=AF_INET;
+	  // The server address, unless the server left it to the
+	  // receiver
+	    ina.sin_addr.s_addr=hdr.m_available;
+	    if(ina.sin_addr.s_addr == htonl(INADDR_ANY)) {
+		ina.sin_addr=from.ia.sin_addr;
+	    }
+	  // The port is already in network byte order
+	    if(CA_V411(protocolRevision)) ina.sin_port=hdr.m_count;
+	    else ina.sin_port=htons(serverPort);
+
+	    CBeaconServer *pServer=getServer(ina,beaconNumber,recvTime);
+	    if(!pServer) continue;
+	    if(updatePeriod(pServer,recvTime,beaconNumber)) {
+		*pName=pServer->name;
+		*pNameLen=pServer->nameLen;
+		*pHash=pServer->hash;
+		*pTime=recvTime;
+		return P_OK;
+	    }
+	}
+
+      // Get another datagram
+	osiSocklen_t addrSize=sizeof(from);
+	int status=recvfrom(sock,buf,MAX_UDP_RECV,0,&from.sa,&addrSize);
+	if(status < 0) {
+	    if(SOCKERRNO == SOCK_EINTR) continue;
+	    epicsSocketConvertErrnoToString(errString,sizeof(errString));
+	    errMsg("Error receiving beacons: %s",errString);
+	    return P_ERROR;
+	}
+	recvTime=epicsTime::getCurrent();
+	cur=buf;
+	end=buf+status;
+    }
+}
+
+// Returns the server for the address, or makes a new one and returns
+// NULL, since the first beacon from a server is not an anomaly
+CBeaconServer *CBeaconListener::getServer(const struct sockaddr_in &addr,
+  unsigned beaconNumber, const epicsTime &time)
+{
+    char key[sizeof(addr.sin_addr.s_addr)+sizeof(addr.sin_port)];
+    CBeaconServer *pServer;
+
+    memcpy(key,&addr.sin_addr.s_addr,sizeof(addr.sin_addr.s_addr));
+    memcpy(key+sizeof(addr.sin_addr.s_addr),&addr.sin_port,
+      sizeof(addr.sin_port));
+    int nServers=addrTable.count();
+    int id=addrTable.intern(key,sizeof(key),
+      CNameTable::hash(key,sizeof(key)));
+    if(id < nServers) return servers[id];
+
+  // It is new
+    if(id >= serversSize) {
+	int newSize=serversSize?2*serversSize:BEACON_SERVERS_SIZE;
+	CBeaconServer **newServers=new CBeaconServer *[newSize];
+	if(!newServers) {
+	    errMsg("Cannot allocate space for beacon servers array");
+	    exit(1);
+	}
+	for(int i=0; i < nServers; i++) newServers[i]=servers[i];
+	if(servers) delete [] servers;
+	servers=newServers;
+	serversSize=newSize;
+    }
+    pServer=new CBeaconServer;
+    if(!pServer) {
+	errMsg("Cannot allocate space for beacon server");
+	exit(1);
+    }
+    pServer->lastTime=time;
+    pServer->averagePeriod=-1.0;
+    pServer->lastBeaconNumber=beaconNumber;
+    ipAddrToA(&addr,pServer->name,sizeof(pServer->name));
+    pServer->nameLen=strlen(pServer->name);
+    pServer->hash=CNameTable::hash(pServer->name,pServer->nameLen);
+    servers[id]=pServer;
+
+    return NULL;
+}
+
+// Updates the period estimate the same way as bhe::updatePeriod.
+// Returns 1 if the beacon is an anomaly.
+int CBeaconListener::updatePeriod(CBeaconServer *pServer,
+  const epicsTime &time, unsigned beaconNumber)
+{
+    int anomaly=0;
+
+  // Discard duplicates from redundant routes and beacons just before
+  // the last one or only a few after it.  Servers before CA 4.10 do not
+  // number their beacons and always send 0.
+    if(beaconNumber || pServer->lastBeaconNumber) {
+	unsigned advance;
+	if(beaconNumber >= pServer->lastBeaconNumber) {
+	    advance=beaconNumber-pServer->lastBeaconNumber;
+	} else {
+	    advance=(0xffffffffu-pServer->lastBeaconNumber)+beaconNumber;
+	}
+	pServer->lastBeaconNumber=beaconNumber;
+	if(advance == 0 || advance > 0xffffffffu-256) return 0;
+	if(advance > 1 && advance < 4) return 0;
+    }
+
+    double period=time-pServer->lastTime;
+    if(pServer->averagePeriod < 0.0) {
+      // The second beacon.  It is an anomaly if the server was not
+      // already up when we started.
+	if(period <= pServer->lastTime-programBeginTime) anomaly=1;
+	pServer->averagePeriod=period;
+    } else {
+      // Three missing beacons or beacons coming faster, as when a
+      // server reboots
+	if(period >= pServer->averagePeriod*3.25) anomaly=1;
+	else if(period <= pServer->averagePeriod*0.80) anomaly=1;
+	pServer->averagePeriod=period*0.125+pServer->averagePeriod*0.875;
+    }
+    pServer->lastTime=time;
+
+    return anomaly;
+}
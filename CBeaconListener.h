@@ -0,0 +1,57 @@
+// Channel Access beacon listener for ParseCASW
+
+#ifndef _INC_CBEACONLISTENER_H
+#define _INC_CBEACONLISTENER_H
+
+#include <stddef.h>
+
+#include <osiSock.h>
+#include <epicsTime.h>
+
+#include "CNameTable.h"
+
+// The beacon period estimate for one server, the same as bhe in the
+// CA client library
+struct CBeaconServer
+{
+    epicsTime lastTime;
+    double averagePeriod;
+    unsigned lastBeaconNumber;
+    char name[64];
+    size_t nameLen;
+    unsigned hash;
+};
+
+// Receives the beacons and finds the anomalies the same way as casw,
+// so that they can be used instead of lines from casw
+class CBeaconListener
+{
+  public:
+    CBeaconListener(void);
+    ~CBeaconListener(void);
+    int open(void);
+    void close(void);
+    int getAnomaly(const char **pName, size_t *pNameLen, unsigned *pHash,
+      epicsTime *pTime);
+
+  private:
+    CBeaconServer *getServer(const struct sockaddr_in &addr,
+      unsigned beaconNumber, const epicsTime &time);
+    int updatePeriod(CBeaconServer *pServer, const epicsTime &time,
+      unsigned beaconNumber);
+
+    SOCKET sock;
+    int attached;
+    unsigned short serverPort;
+    epicsTime programBeginTime;
+    CNameTable addrTable;
+    CBeaconServer **servers;
+    int serversSize;
+    char *buf;
+    const char *cur;
+    const char *end;
+    osiSockAddr from;
+    epicsTime recvTime;
+};
+
+#endif // _INC_CBEACONLISTENER_H
@@ -0,0 +1,240 @@
+// Implementation of parallel analysis of a mapped file in chunks
+
+// Each chunk is a range of whole lines.  A thread for each chunk
+// parses its lines and builds groups for each server the same way
+// CIoc::update does.  The chunks are then merged in order into the
+// global table.  A server's events at the start of a chunk, up to the
+// first gap greater than newGroupTime, might continue the last group
+// from the previous chunk, so they are kept as times and replayed
+// through CIoc::update when merging.  After that gap a new group
+// starts regardless of the previous chunks, so the rest of the groups
+// and their running statistics are exactly as a serial run would
+// make them and are moved over as is.  Servers are added to the
+// global table in the order they first appear, as in a serial run.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <epicsThread.h>
+
+#include "parsecasw.h"
+#include "utils.h"
+#include "CMappedFile.h"
+#include "CChunk.h"
+
+// Initial size of the arrays, which double as needed
+#define CHUNK_ARRAY_SIZE 16
+
+static void chunkThread(void *arg);
+
+// Class CChunkIoc implementations
+
+CChunkIoc::CChunkIoc(const char *nameIn, int idIn, epicsTime &time,
+  CGroupStore &store) :
+    name(nameIn),
+    id(idIn),
+    pStore(&store),
+    headTimes(NULL),
+    nHead(0),
+    headSize(0),
+    lastTime(time),
+    pIoc(NULL)
+{
+    update(time,0.0);
+}
+
+CChunkIoc::~CChunkIoc(void)
+{
+    if(headTimes) delete [] headTimes;
+    CIoc::destroy(pIoc);
+}
+
+void CChunkIoc::update(epicsTime &time, double newGroupTime)
+{
+  // After the head use the CIoc
+    if(pIoc) {
+	pIoc->update(time,newGroupTime);
+	return;
+    }
+
+  // The head ends at the first gap greater than newGroupTime
+    if(nHead && time-lastTime > newGroupTime) {
+	pIoc=new(*pStore) CIoc(name,id,time,*pStore);
+	if(!pIoc) {
+	    errMsg("Failed to create IOC entry for %s\n",name);
+	    exit(1);
+	}
+	return;
+    }
+
+  // Add it to the head
+    if(nHead >= headSize) {
+	int newSize=headSize?2*headSize:CHUNK_ARRAY_SIZE;
+	epicsTime *newTimes=new epicsTime[newSize];
+	if(!newTimes) {
+	    errMsg("Cannot allocate space for head times array");
+	    exit(1);
+	}
+	for(int i=0; i < nHead; i++) newTimes[i]=headTimes[i];
+	if(headTimes) delete [] headTimes;
+	headTimes=newTimes;
+	headSize=newSize;
+    }
+    headTimes[nHead++]=time;
+    lastTime=time;
+}
+
+// Class CChunk implementations
+
+CChunk::CChunk(const char *start, const char *end, CaswFileType fileTypeIn,
+  const CTimeCache &timeCacheIn, const CNameFilter &nameFilterIn,
+  double newGroupTimeIn) :
+    startPtr(start),
+    endPtr(end),
+    fileType(fileTypeIn),
+    timeCache(timeCacheIn),
+    nameFilter(nameFilterIn),
+    newGroupTime(newGroupTimeIn),
+    linesSkipped(0),
+    linesFiltered(0),
+    doneEvent(NULL),
+    chunkIocs(NULL),
+    nChunkIocs(0),
+    chunkIocsSize(0)
+{
+    for(int i=0; i < FT_NFORMATS; i++) lineCounts[i]=0;
+}
+
+CChunk::~CChunk(void)
+{
+    for(int i=0; i < nChunkIocs; i++) delete chunkIocs[i];
+    if(chunkIocs) delete [] chunkIocs;
+    if(doneEvent) epicsEventDestroy(doneEvent);
+}
+
+// Starts the thread.  Returns P_OK or P_ERROR.
+int CChunk::start(void)
+{
+    doneEvent=epicsEventCreate(epicsEventEmpty);
+    if(!doneEvent) return P_ERROR;
+    epicsThreadId tid=epicsThreadCreate("parsecaswChunk",
+      epicsThreadPriorityMedium,
+      epicsThreadGetStackSize(epicsThreadStackMedium),
+      chunkThread,this);
+    if(!tid) return P_ERROR;
+    return P_OK;
+}
+
+// Waits for the thread to finish
+void CChunk::wait(void)
+{
+    if(doneEvent) epicsEventWait(doneEvent);
+}
+
+// Parses the lines and makes the groups
+void CChunk::run(void)
+{
+    const char *cur=startPtr;
+    const char *end;
+    CaswLine caswLine;
+    epicsTime time;
+    CChunkIoc *pChunkIoc;
+    int id;
+
+    while(cur < endPtr) {
+	end=CMappedFile::frameLine(cur,endPtr);
+	int status=parseLine(cur,end,fileType,&caswLine);
+	cur=end;
+	if(status != P_OK) {
+	    linesSkipped++;
+	    continue;
+	}
+	if(timeCache.getTime(&caswLine,&time) != P_OK) {
+	    linesSkipped++;
+	    continue;
+	}
+	if(!nameFilter.accepts(caswLine.name,caswLine.nameLen)) {
+	    linesFiltered++;
+	    continue;
+	}
+	lineCounts[caswLine.fileType]++;
+
+      // The ids are in the order the names first appear and index
+      // chunkIocs
+	id=chunkNames.intern(caswLine.name,caswLine.nameLen,
+	  CNameTable::hash(caswLine.name,caswLine.nameLen));
+	if(id < nChunkIocs) {
+	    chunkIocs[id]->update(time,newGroupTime);
+	    continue;
+	}
+
+	pChunkIoc=new CChunkIoc(chunkNames.getName(id),id,time,chunkGroups);
+	if(!pChunkIoc) {
+	    errMsg("Failed to create chunk IOC entry for %s",
+	      chunkNames.getName(id));
+	    exit(1);
+	}
+	if(nChunkIocs >= chunkIocsSize) {
+	    int newSize=chunkIocsSize?2*chunkIocsSize:CHUNK_ARRAY_SIZE;
+	    CChunkIoc **newIocs=new CChunkIoc *[newSize];
+	    if(!newIocs) {
+		errMsg("Cannot allocate space for chunk IOC array");
+		exit(1);
+	    }
+	    for(int i=0; i < nChunkIocs; i++) newIocs[i]=chunkIocs[i];
+	    if(chunkIocs) delete [] chunkIocs;
+	    chunkIocs=newIocs;
+	    chunkIocsSize=newSize;
+	}
+	chunkIocs[nChunkIocs++]=pChunkIoc;
+    }
+
+    if(doneEvent) epicsEventSignal(doneEvent);
+}
+
+// Merges the servers and groups into the table, which has the results
+// of all the previous chunks
+void CChunk::merge(CNameTable &names, CIocTable &iocTable,
+  CGroupStore &groupStore)
+{
+    for(int i=0; i < nChunkIocs; i++) {
+	CChunkIoc *pChunkIoc=chunkIocs[i];
+	epicsTime *headTimes=pChunkIoc->getHeadTimes();
+	int nHead=pChunkIoc->getHeadCount();
+	int iHead=0;
+
+      // Replay the head
+	int id=names.intern(chunkNames.getName(i),chunkNames.getLength(i),
+	  chunkNames.getHash(i));
+	CIoc *pIoc=iocTable.lookup(id);
+	if(!pIoc) {
+	    pIoc=new(groupStore) CIoc(names.getName(id),id,headTimes[0],
+	      groupStore);
+	    if(!pIoc) {
+		errMsg("Failed to create IOC entry for %s",names.getName(id));
+		exit(1);
+	    }
+	    iocTable.add(*pIoc);
+	    iHead=1;
+	}
+	for(; iHead < nHead; iHead++) {
+	    pIoc->update(headTimes[iHead],newGroupTime);
+	}
+
+      // Move the rest of the groups
+	CIoc *pChunkCIoc=pChunkIoc->getIoc();
+	if(pChunkCIoc) {
+	    pIoc->append(*pChunkCIoc);
+	    CIoc::destroy(pChunkCIoc);
+	    pChunkIoc->setIoc(NULL);
+	}
+    }
+}
+
+static void chunkThread(void *arg)
+{
+    CChunk *pChunk=(CChunk *)arg;
+
+    pChunk->run();
+}
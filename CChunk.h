@@ -0,0 +1,79 @@
+// Classes for parallel analysis of a mapped file in chunks
+
+#ifndef _INC_CCHUNK_H
+#define _INC_CCHUNK_H
+
+#include <epicsTime.h>
+#include <epicsEvent.h>
+
+#include "parseLine.h"
+#include "CNameTable.h"
+#include "CGroupStore.h"
+#include "CIoc.h"
+#include "CNameFilter.h"
+
+// The state of one server within a chunk.  The events up to the first
+// gap greater than newGroupTime are the head, which may continue a
+// group from the previous chunk.  They are kept as times and replayed
+// when the chunks are merged.  The events after that are in pIoc.  The
+// name and id are from the name table of the chunk, and the groups are
+// in the group store of the chunk.
+class CChunkIoc
+{
+  public:
+    CChunkIoc(const char *name, int id, epicsTime &time,
+      CGroupStore &store);
+    ~CChunkIoc(void);
+    void update(epicsTime &time, double newGroupTime);
+    int getHeadCount(void) const { return nHead; }
+    epicsTime *getHeadTimes(void) const { return headTimes; }
+    CIoc *getIoc(void) const { return pIoc; }
+    void setIoc(CIoc *pIocIn) { pIoc=pIocIn; }
+
+  private:
+    const char *name;
+    int id;
+    CGroupStore *pStore;
+    epicsTime *headTimes;
+    int nHead;
+    int headSize;
+    epicsTime lastTime;
+    CIoc *pIoc;
+};
+
+// One chunk of lines, analyzed by its own thread
+class CChunk
+{
+  public:
+    CChunk(const char *start, const char *end, CaswFileType fileType,
+      const CTimeCache &timeCache, const CNameFilter &nameFilter,
+      double newGroupTime);
+    ~CChunk(void);
+    int start(void);
+    void wait(void);
+    void run(void);
+    void merge(CNameTable &names, CIocTable &iocTable,
+      CGroupStore &groupStore);
+    int getLinesSkipped(void) const { return linesSkipped; }
+    int getLinesFiltered(void) const { return linesFiltered; }
+    int getLineCount(CaswFileType type) const { return lineCounts[type]; }
+
+  private:
+    const char *startPtr;
+    const char *endPtr;
+    CaswFileType fileType;
+    CTimeCache timeCache;
+    const CNameFilter &nameFilter;
+    double newGroupTime;
+    int linesSkipped;
+    int linesFiltered;
+    int lineCounts[FT_NFORMATS];
+    epicsEventId doneEvent;
+    CNameTable chunkNames;
+    CGroupStore chunkGroups;
+    CChunkIoc **chunkIocs;
+    int nChunkIocs;
+    int chunkIocsSize;
+};
+
+#endif // _INC_CCHUNK_H
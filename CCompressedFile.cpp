@@ -0,0 +1,461 @@
+// Implementation of the compressed input file for ParseCASW
+
+// The file type is found from the magic bytes at its start.  A
+// decoder thread reads the compressed data and decodes it into a ring
+// of DECODE_NBLOCKS blocks, which read() copies out of, so the
+// decoding overlaps with the parsing.  Concatenated members, as made
+// by appending to a compressed log, are read as one file.  Each
+// library is only used if the corresponding HAVE_ZLIB, HAVE_LZMA, or
+// HAVE_ZSTD is defined.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <epicsThread.h>
+
+#include "utils.h"
+#include "CCompressedFile.h"
+
+// Size of a decoded block
+#define DECODE_BLOCK_SIZE 1048576
+// Size of the reads of compressed data
+#define DECODE_INPUT_SIZE 262144
+
+static void decodeThread(void *arg);
+
+CCompressedFile::CCompressedFile(void) :
+    fp(NULL),
+    type(CT_NONE),
+    status(P_OK),
+    errorString(NULL),
+    threadStarted(0),
+    lock(NULL),
+    fullEvent(NULL),
+    freeEvent(NULL),
+    exitEvent(NULL),
+    head(0),
+    nFull(0),
+    done(0),
+    stop(0),
+    cur(NULL),
+    blockEnd(NULL),
+    haveBlock(0),
+    inBuf(NULL),
+    inPos(0),
+    inLen(0),
+    inEof(0),
+    streamEnd(0)
+#ifdef HAVE_ZSTD
+    ,zstdStream(NULL)
+#endif
+{
+    for(int i=0; i < DECODE_NBLOCKS; i++) {
+	blocks[i]=NULL;
+	lengths[i]=0;
+    }
+}
+
+CCompressedFile::~CCompressedFile(void)
+{
+    close();
+}
+
+// Returns the type of compression from the magic bytes at the start
+// of the file, or CT_NONE
+CompressionType CCompressedFile::detect(const char *fileName)
+{
+    unsigned char magic[6];
+    size_t n;
+
+    FILE *file=fopen(fileName,"rb");
+    if(!file) return CT_NONE;
+    n=fread(magic,1,sizeof(magic),file);
+    fclose(file);
+
+    if(n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) return CT_GZIP;
+    if(n >= 6 && !memcmp(magic,"\xfd" "7zXZ\0",6)) return CT_XZ;
+    if(n >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 &&
+      magic[2] == 0x2f && magic[3] == 0xfd) return CT_ZSTD;
+    return CT_NONE;
+}
+
+const char *CCompressedFile::typeName(CompressionType type)
+{
+    switch(type) {
+    case CT_GZIP:
+	return "gzip";
+    case CT_XZ:
+	return "xz";
+    case CT_ZSTD:
+	return "zstd";
+    default:
+	return "uncompressed";
+    }
+}
+
+// Opens the file and starts the decoder thread.  Returns P_OK or
+// P_ERROR, in which case getErrorString() tells why.
+int CCompressedFile::open(const char *fileName, CompressionType typeIn)
+{
+    close();
+    type=typeIn;
+    status=P_OK;
+    errorString=NULL;
+
+    fp=fopen(fileName,"rb");
+    if(!fp) {
+	setError("Cannot open file");
+	return P_ERROR;
+    }
+    if(initDecoder() != P_OK) {
+	close();
+	status=P_ERROR;
+	return P_ERROR;
+    }
+
+    inBuf=new unsigned char[DECODE_INPUT_SIZE];
+    if(!inBuf) {
+	errMsg("Cannot allocate space for compressed input");
+	exit(1);
+    }
+    for(int i=0; i < DECODE_NBLOCKS; i++) {
+	blocks[i]=new char[DECODE_BLOCK_SIZE];
+	if(!blocks[i]) {
+	    errMsg("Cannot allocate space for decoded blocks");
+	    exit(1);
+	}
+    }
+
+    lock=epicsMutexCreate();
+    fullEvent=epicsEventCreate(epicsEventEmpty);
+    freeEvent=epicsEventCreate(epicsEventEmpty);
+    exitEvent=epicsEventCreate(epicsEventEmpty);
+    if(!lock || !fullEvent || !freeEvent || !exitEvent) {
+	close();
+	setError("Cannot create decoder thread synchronization");
+	return P_ERROR;
+    }
+    epicsThreadId tid=epicsThreadCreate("parsecaswDecode",
+      epicsThreadPriorityMedium,
+      epicsThreadGetStackSize(epicsThreadStackMedium),
+      decodeThread,this);
+    if(!tid) {
+	close();
+	setError("Cannot start decoder thread");
+	return P_ERROR;
+    }
+    threadStarted=1;
+
+    return P_OK;
+}
+
+// Stops the decoder thread if it is still running and frees
+// everything.  The status is kept.
+void CCompressedFile::close(void)
+{
+    if(threadStarted) {
+	epicsMutexLock(lock);
+	stop=1;
+	epicsMutexUnlock(lock);
+	epicsEventSignal(freeEvent);
+	epicsEventWait(exitEvent);
+	threadStarted=0;
+    }
+    if(fp) {
+	endDecoder();
+	fclose(fp);
+	fp=NULL;
+    }
+    if(lock) epicsMutexDestroy(lock);
+    if(fullEvent) epicsEventDestroy(fullEvent);
+    if(freeEvent) epicsEventDestroy(freeEvent);
+    if(exitEvent) epicsEventDestroy(exitEvent);
+    lock=NULL;
+    fullEvent=freeEvent=exitEvent=NULL;
+    for(int i=0; i < DECODE_NBLOCKS; i++) {
+	if(blocks[i]) delete [] blocks[i];
+	blocks[i]=NULL;
+    }
+    if(inBuf) delete [] inBuf;
+    inBuf=NULL;
+    head=nFull=done=stop=0;
+    cur=blockEnd=NULL;
+    haveBlock=0;
+    inPos=inLen=0;
+    inEof=streamEnd=0;
+}
+
+// Copies up to size bytes of the decoded data into buf, waiting for
+// the decoder thread if necessary.  Returns the number of bytes, which
+// is 0 at the end of the data or on an error.
+size_t CCompressedFile::read(char *buf, size_t size)
+{
+    size_t len=0;
+
+    while(len < size) {
+	if(cur >= blockEnd) {
+	  // Do not wait if there is already something to return
+	    if(len) break;
+	    if(!nextBlock()) break;
+	    continue;
+	}
+	size_t n=(size_t)(blockEnd-cur);
+	if(n > size-len) n=size-len;
+	memcpy(buf+len,cur,n);
+	len+=n;
+	cur+=n;
+    }
+
+    return len;
+}
+
+// Gives the current block back to the decoder thread and waits for the
+// next one.  Returns 0 if there are no more.
+int CCompressedFile::nextBlock(void)
+{
+    if(!threadStarted) return 0;
+
+    epicsMutexLock(lock);
+    if(haveBlock) {
+	head=(head+1)%DECODE_NBLOCKS;
+	nFull--;
+	haveBlock=0;
+	epicsMutexUnlock(lock);
+	epicsEventSignal(freeEvent);
+	epicsMutexLock(lock);
+    }
+    while(!nFull && !done) {
+	epicsMutexUnlock(lock);
+	epicsEventWait(fullEvent);
+	epicsMutexLock(lock);
+    }
+    if(!nFull) {
+	epicsMutexUnlock(lock);
+	cur=blockEnd=NULL;
+	return 0;
+    }
+    cur=blocks[head];
+    blockEnd=cur+lengths[head];
+    haveBlock=1;
+    epicsMutexUnlock(lock);
+
+    return 1;
+}
+
+// The decoder thread.  Fills the free blocks until the end of the data,
+// an error, or close().
+void CCompressedFile::run(void)
+{
+    int index;
+    size_t len;
+
+    while(1) {
+	epicsMutexLock(lock);
+	while(nFull >= DECODE_NBLOCKS && !stop) {
+	    epicsMutexUnlock(lock);
+	    epicsEventWait(freeEvent);
+	    epicsMutexLock(lock);
+	}
+	if(stop) {
+	    epicsMutexUnlock(lock);
+	    break;
+	}
+	index=(head+nFull)%DECODE_NBLOCKS;
+	epicsMutexUnlock(lock);
+
+	len=decode(blocks[index],DECODE_BLOCK_SIZE);
+	if(!len) break;
+
+	epicsMutexLock(lock);
+	lengths[index]=len;
+	nFull++;
+	epicsMutexUnlock(lock);
+	epicsEventSignal(fullEvent);
+    }
+
+    epicsMutexLock(lock);
+    done=1;
+    epicsMutexUnlock(lock);
+    epicsEventSignal(fullEvent);
+    epicsEventSignal(exitEvent);
+}
+
+void CCompressedFile::setError(const char *string)
+{
+    status=P_ERROR;
+    errorString=string;
+}
+
+int CCompressedFile::initDecoder(void)
+{
+    switch(type) {
+#ifdef HAVE_ZLIB
+    case CT_GZIP:
+	memset(&zStream,0,sizeof(zStream));
+      // 32 to detect a gzip or zlib header
+	if(inflateInit2(&zStream,15+32) != Z_OK) {
+	    setError("Cannot initialize gzip decoder");
+	    return P_ERROR;
+	}
+	return P_OK;
+#endif
+#ifdef HAVE_LZMA
+    case CT_XZ:
+	{
+	    lzma_stream init=LZMA_STREAM_INIT;
+	    lzmaStream=init;
+	    if(lzma_stream_decoder(&lzmaStream,UINT64_MAX,
+		 LZMA_CONCATENATED) != LZMA_OK) {
+		setError("Cannot initialize xz decoder");
+		return P_ERROR;
+	    }
+	}
+	return P_OK;
+#endif
+#ifdef HAVE_ZSTD
+    case CT_ZSTD:
+	zstdStream=ZSTD_createDStream();
+	if(!zstdStream || ZSTD_isError(ZSTD_initDStream(zstdStream))) {
+	    setError("Cannot initialize zstd decoder");
+	    return P_ERROR;
+	}
+	return P_OK;
+#endif
+    default:
+	setError("This build does not support this type of compression");
+	return P_ERROR;
+    }
+}
+
+void CCompressedFile::endDecoder(void)
+{
+    switch(type) {
+#ifdef HAVE_ZLIB
+    case CT_GZIP:
+	inflateEnd(&zStream);
+	break;
+#endif
+#ifdef HAVE_LZMA
+    case CT_XZ:
+	lzma_end(&lzmaStream);
+	break;
+#endif
+#ifdef HAVE_ZSTD
+    case CT_ZSTD:
+	if(zstdStream) ZSTD_freeDStream(zstdStream);
+	zstdStream=NULL;
+	break;
+#endif
+    default:
+	break;
+    }
+}
+
+// Decodes into out until it is full or the data ends.  Returns the
+// number of bytes, which is 0 at the end or after an error.  The
+// unused input is from inPos to inLen in inBuf.
+size_t CCompressedFile::decode(char *out, size_t size)
+{
+    size_t outPos=0;
+    size_t prevOut,prevIn;
+
+    if(status != P_OK) return 0;
+
+    while(outPos < size) {
+      // Read more input when it is used up
+	if(inPos >= inLen && !inEof) {
+	    inPos=0;
+	    inLen=fread(inBuf,1,DECODE_INPUT_SIZE,fp);
+	    if(ferror(fp)) {
+		setError("Error reading file");
+		break;
+	    }
+	    if(!inLen) inEof=1;
+	}
+	if(inPos >= inLen && inEof && streamEnd) break;
+
+	prevOut=outPos;
+	prevIn=inPos;
+	switch(type) {
+#ifdef HAVE_ZLIB
+	case CT_GZIP:
+	    {
+		zStream.next_in=(Bytef *)(inBuf+inPos);
+		zStream.avail_in=(uInt)(inLen-inPos);
+		zStream.next_out=(Bytef *)(out+outPos);
+		zStream.avail_out=(uInt)(size-outPos);
+		int ret=inflate(&zStream,Z_NO_FLUSH);
+		outPos=size-zStream.avail_out;
+		inPos=inLen-zStream.avail_in;
+		if(ret == Z_STREAM_END) {
+		  // Get ready for another member
+		    inflateReset(&zStream);
+		    streamEnd=1;
+		} else if(ret == Z_OK || ret == Z_BUF_ERROR) {
+		    if(outPos != prevOut || inPos != prevIn) streamEnd=0;
+		} else {
+		    setError(zStream.msg?zStream.msg:"Invalid gzip data");
+		}
+	    }
+	    break;
+#endif
+#ifdef HAVE_LZMA
+	case CT_XZ:
+	    {
+		lzmaStream.next_in=inBuf+inPos;
+		lzmaStream.avail_in=inLen-inPos;
+		lzmaStream.next_out=(uint8_t *)(out+outPos);
+		lzmaStream.avail_out=size-outPos;
+	      // LZMA_CONCATENATED only ends with LZMA_FINISH
+		lzma_ret ret=lzma_code(&lzmaStream,inEof?LZMA_FINISH:LZMA_RUN);
+		outPos=size-lzmaStream.avail_out;
+		inPos=inLen-lzmaStream.avail_in;
+		if(ret == LZMA_STREAM_END) streamEnd=1;
+		else if(ret != LZMA_OK && ret != LZMA_BUF_ERROR) {
+		    setError("Invalid xz data");
+		}
+	    }
+	    break;
+#endif
+#ifdef HAVE_ZSTD
+	case CT_ZSTD:
+	    {
+		ZSTD_inBuffer in={inBuf,inLen,inPos};
+		ZSTD_outBuffer zOut={out,size,outPos};
+		size_t ret=ZSTD_decompressStream(zstdStream,&zOut,&in);
+		outPos=zOut.pos;
+		inPos=in.pos;
+		if(ZSTD_isError(ret)) setError(ZSTD_getErrorName(ret));
+	      // 0 means a frame is done and flushed
+		else streamEnd=(ret == 0);
+	    }
+	    break;
+#endif
+	default:
+	    setError("This build does not support this type of compression");
+	    break;
+	}
+	if(status != P_OK) break;
+
+      // Check for no progress
+	if(outPos == prevOut && inPos == prevIn) {
+	    if(inPos < inLen) {
+		setError("Invalid compressed data");
+		break;
+	    }
+	    if(inEof) {
+		if(!streamEnd) setError("Unexpected end of compressed data");
+		break;
+	    }
+	}
+    }
+
+    return outPos;
+}
+
+static void decodeThread(void *arg)
+{
+    CCompressedFile *pFile=(CCompressedFile *)arg;
+
+    pFile->run();
+}
@@ -0,0 +1,98 @@
+// Compressed input file for ParseCASW
+
+#ifndef _INC_CCOMPRESSEDFILE_H
+#define _INC_CCOMPRESSEDFILE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <epicsMutex.h>
+#include <epicsEvent.h>
+
+#include "parsecasw.h"
+
+#ifdef HAVE_ZLIB
+# include <zlib.h>
+#endif
+#ifdef HAVE_LZMA
+# include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+# include <zstd.h>
+#endif
+
+typedef enum _CompressionType {
+    CT_NONE,
+    CT_GZIP,
+    CT_XZ,
+    CT_ZSTD
+} CompressionType;
+
+// Number of decoded blocks between the decoder thread and the reader
+#define DECODE_NBLOCKS 4
+
+// A file that is decompressed by its own thread into a ring of
+// blocks.  The decoded data is read with read().
+class CCompressedFile
+{
+  public:
+    CCompressedFile(void);
+    ~CCompressedFile(void);
+    static CompressionType detect(const char *fileName);
+    static const char *typeName(CompressionType type);
+    int open(const char *fileName, CompressionType type);
+    void close(void);
+    int isOpen(void) const { return fp != NULL; }
+    size_t read(char *buf, size_t size);
+    int getStatus(void) const { return status; }
+    const char *getErrorString(void) const { return errorString; }
+    void run(void);
+
+  private:
+    int nextBlock(void);
+    int initDecoder(void);
+    size_t decode(char *out, size_t size);
+    void endDecoder(void);
+    void setError(const char *string);
+
+    FILE *fp;
+    CompressionType type;
+    int status;
+    const char *errorString;
+    int threadStarted;
+
+  // Shared with the decoder thread
+    epicsMutexId lock;
+    epicsEventId fullEvent;
+    epicsEventId freeEvent;
+    epicsEventId exitEvent;
+    char *blocks[DECODE_NBLOCKS];
+    size_t lengths[DECODE_NBLOCKS];
+    int head;
+    int nFull;
+    int done;
+    int stop;
+
+  // Reader state
+    const char *cur;
+    const char *blockEnd;
+    int haveBlock;
+
+  // Decoder state
+    unsigned char *inBuf;
+    size_t inPos;
+    size_t inLen;
+    int inEof;
+    int streamEnd;
+#ifdef HAVE_ZLIB
+    z_stream zStream;
+#endif
+#ifdef HAVE_LZMA
+    lzma_stream lzmaStream;
+#endif
+#ifdef HAVE_ZSTD
+    ZSTD_DStream *zstdStream;
+#endif
+};
+
+#endif // _INC_CCOMPRESSEDFILE_H
@@ -0,0 +1,285 @@
+// Implementation of the cache of the parsed events for ParseCASW
+
+// The events are written as they are parsed, and the names, which are
+// only all known at the end, are written after them.  The header is
+// written last, over a blank one, and the file is renamed from its
+// temporary name only then, so a cache that is incomplete is never
+// used.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parsecasw.h"
+#include "utils.h"
+#include "CEventCache.h"
+
+// Suffix of the temporary file while it is written
+#define CACHE_TEMP_SUFFIX ".tmp"
+
+// Largest size of an encoded event
+#define CACHE_EVENT_SIZE 15
+
+static inline unsigned char *putVarint(unsigned char *p, epicsUInt64 value)
+{
+    while(value >= 0x80) {
+	*p++=(unsigned char)(value | 0x80);
+	value>>=7;
+    }
+    *p++=(unsigned char)value;
+    return p;
+}
+
+// Returns NULL if the value runs past end or is too long
+static inline const unsigned char *getVarint(const unsigned char *p,
+  const unsigned char *end, epicsUInt64 *value)
+{
+    epicsUInt64 result=0;
+
+    for(int shift=0; p < end && shift < 64; shift+=7) {
+	unsigned char c=*p++;
+	result|=(epicsUInt64)(c & 0x7f) << shift;
+	if(!(c & 0x80)) {
+	    *value=result;
+	    return p;
+	}
+    }
+    return NULL;
+}
+
+// Class CEventCache implementations
+
+CEventCache::CEventCache(void) :
+    errorString(NULL),
+    lastKey(0),
+    fp(NULL),
+    buffer(NULL),
+    bufferLen(0),
+    writeError(0),
+    cur(NULL),
+    eventsEnd(NULL),
+    names(NULL)
+{
+    memset(&header,0,sizeof(header));
+    cacheName[0]=tempName[0]='\0';
+}
+
+CEventCache::~CEventCache(void)
+{
+    abandon();
+    close();
+    if(buffer) delete [] buffer;
+}
+
+// Makes the name of the cache of an input file.  Returns P_OK or
+// P_ERROR if it is too long.
+int CEventCache::makeFileName(const char *inputName, char *cacheName,
+  size_t size)
+{
+  // Leave room for the temporary suffix
+    if(size <= strlen(CACHE_TEMP_SUFFIX) ||
+      makeStampedName(inputName,CACHE_SUFFIX,cacheName,
+	size-strlen(CACHE_TEMP_SUFFIX))) {
+	return P_ERROR;
+    }
+    return P_OK;
+}
+
+// Starts writing the cache for an input file.  Returns P_OK or
+// P_ERROR.
+int CEventCache::create(const char *cacheNameIn, const char *inputName,
+  epicsUInt32 options)
+{
+    CacheHeader blank;
+
+    abandon();
+    errorString=NULL;
+    memset(&header,0,sizeof(header));
+    if(initStampedHeader(header.stamped,CACHE_MAGIC,CACHE_VERSION,
+	 inputName,options)) {
+	errorString="Cannot get the size and time of the input";
+	return P_ERROR;
+    }
+
+    strcpy(cacheName,cacheNameIn);
+    strcpy(tempName,cacheNameIn);
+    strcat(tempName,CACHE_TEMP_SUFFIX);
+    fp=fopen(tempName,"wb");
+    if(!fp) {
+	errorString="Cannot open file";
+	return P_ERROR;
+    }
+    if(!buffer) {
+	buffer=new unsigned char[CACHE_BUFFER_SIZE];
+	if(!buffer) {
+	    errMsg("Cannot allocate space for cache buffer");
+	    exit(1);
+	}
+    }
+
+  // A blank header is written over at the end
+    memset(&blank,0,sizeof(blank));
+    writeError=fwrite(&blank,sizeof(blank),1,fp) != 1;
+    bufferLen=0;
+    lastKey=0;
+
+    return P_OK;
+}
+
+// Adds an event to the cache that is being written
+void CEventCache::add(int id, const epicsTime &time)
+{
+    if(bufferLen+CACHE_EVENT_SIZE > CACHE_BUFFER_SIZE) flushBuffer();
+
+    epicsInt64 key=timeToNs(time);
+    epicsInt64 delta=key-lastKey;
+    lastKey=key;
+    unsigned char *p=buffer+bufferLen;
+    p=putVarint(p,(epicsUInt64)id);
+    p=putVarint(p,((epicsUInt64)delta << 1) ^ (epicsUInt64)(delta >> 63));
+    bufferLen=p-buffer;
+    header.nEvents++;
+}
+
+void CEventCache::flushBuffer(void)
+{
+    if(bufferLen > 0 && !writeError) {
+	writeError=fwrite(buffer,bufferLen,1,fp) != 1;
+    }
+    header.eventsSize+=bufferLen;
+    bufferLen=0;
+}
+
+// Writes the names and the header and renames the cache into place.
+// Returns P_OK or P_ERROR.
+int CEventCache::finish(const CNameTable &nameTable, int linesSkipped,
+  const int lineCounts[FT_NFORMATS])
+{
+    if(!fp) return P_ERROR;
+    flushBuffer();
+
+    size_t namesSize=0;
+    for(int id=0; id < nameTable.count() && !writeError; id++) {
+	size_t len=nameTable.getLength(id)+1;
+	writeError=fwrite(nameTable.getName(id),len,1,fp) != 1;
+	namesSize+=len;
+    }
+
+    header.linesSkipped=linesSkipped;
+    for(int type=0; type < FT_NFORMATS; type++) {
+	header.lineCounts[type]=lineCounts[type];
+    }
+    header.nNames=(epicsUInt32)nameTable.count();
+    header.namesSize=(epicsUInt32)namesSize;
+    if(!writeError) {
+	writeError=fseek(fp,0,SEEK_SET) ||
+	  fwrite(&header,sizeof(header),1,fp) != 1;
+    }
+    if(fclose(fp)) writeError=1;
+    fp=NULL;
+    if(writeError) {
+	errorString="Error writing file";
+	remove(tempName);
+	return P_ERROR;
+    }
+
+  // Windows does not replace an existing file on rename
+#ifdef WIN32
+    remove(cacheName);
+#endif
+    if(rename(tempName,cacheName)) {
+	errorString="Cannot rename file";
+	remove(tempName);
+	return P_ERROR;
+    }
+
+    return P_OK;
+}
+
+// Stops writing the cache and removes what was written
+void CEventCache::abandon(void)
+{
+    if(!fp) return;
+    fclose(fp);
+    fp=NULL;
+    remove(tempName);
+}
+
+// Maps the cache of an input file and checks that it is up to date.
+// Returns P_OK or P_ERROR.
+int CEventCache::open(const char *cacheNameIn, const char *inputName,
+  epicsUInt32 options)
+{
+    close();
+    errorString=NULL;
+    if(mappedFile.open(cacheNameIn) != P_OK) {
+	errorString="Cannot map file";
+	return P_ERROR;
+    }
+    if(mappedFile.getSize() < sizeof(header)) {
+	errorString="Not a cache file";
+	close();
+	return P_ERROR;
+    }
+    memcpy(&header,mappedFile.getBegin(),sizeof(header));
+    errorString=checkStampedHeader(header.stamped,CACHE_MAGIC,
+      CACHE_VERSION,inputName,options);
+    if(errorString) {
+	close();
+	return P_ERROR;
+    }
+    if(sizeof(header)+header.eventsSize+header.namesSize !=
+      mappedFile.getSize()) {
+	errorString="Cache file is the wrong size";
+	close();
+	return P_ERROR;
+    }
+
+  // Check the names, so they can be used in place
+    cur=(const unsigned char *)mappedFile.getBegin()+sizeof(header);
+    eventsEnd=cur+header.eventsSize;
+    names=(const char *)eventsEnd;
+    epicsUInt32 nNames=0;
+    for(epicsUInt32 i=0; i < header.namesSize; i++) {
+	if(!names[i]) nNames++;
+    }
+    if(nNames != header.nNames ||
+      (header.namesSize > 0 && names[header.namesSize-1])) {
+	errorString="Cache file has bad names";
+	close();
+	return P_ERROR;
+    }
+    lastKey=0;
+
+    return P_OK;
+}
+
+void CEventCache::close(void)
+{
+    mappedFile.close();
+    cur=eventsEnd=NULL;
+    names=NULL;
+}
+
+// Gets the next event.  Returns 1 if there is one, else 0, with the
+// error string set if the events are bad.
+int CEventCache::next(int *id, epicsTime *time)
+{
+    epicsUInt64 idValue,zigzag;
+    epicsTimeStamp stamp;
+
+    if(cur >= eventsEnd) return 0;
+    cur=getVarint(cur,eventsEnd,&idValue);
+    if(cur) cur=getVarint(cur,eventsEnd,&zigzag);
+    if(!cur || idValue >= header.nNames) {
+	errorString="Cache file has bad events";
+	cur=eventsEnd;
+	return 0;
+    }
+
+    lastKey+=(epicsInt64)(zigzag >> 1) ^ -(epicsInt64)(zigzag & 1);
+    nsToTime(lastKey,stamp);
+    *id=(int)idValue;
+    *time=stamp;
+    return 1;
+}
@@ -0,0 +1,94 @@
+// Cache of the parsed events of an input file for ParseCASW
+
+#ifndef _INC_CEVENTCACHE_H
+#define _INC_CEVENTCACHE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <epicsTypes.h>
+#include <epicsTime.h>
+
+#include "parseLine.h"
+#include "utils.h"
+#include "CMappedFile.h"
+#include "CNameTable.h"
+
+#define CACHE_MAGIC "PCASWCA"
+#define CACHE_VERSION 2
+// Appended to the name of the input file to get the name of the cache
+#define CACHE_SUFFIX ".pcache"
+// Size of the buffer for the events that are being written
+#define CACHE_BUFFER_SIZE 65536
+
+// The header is followed by the events and then by the names, each
+// NUL terminated, in the order of their ids.  The options are those
+// that affect the parsing, including the time zone.
+struct CacheHeader
+{
+    StampedHeader stamped;
+    epicsInt32 linesSkipped;
+    epicsInt32 lineCounts[FT_NFORMATS];
+    epicsUInt32 nNames;
+    epicsUInt32 namesSize;
+    epicsUInt64 nEvents;
+    epicsUInt64 eventsSize;
+};
+
+// The parsed events of an input file, as (server id, time) in input
+// order, so that a later run can skip parsing the text.  Each event is
+// the id as a variable-length integer and the difference from the time
+// of the event before in nanoseconds as a zigzag variable-length
+// integer, which is usually 4 or 5 bytes in all.  It is written to a
+// temporary file as the events are added, so the memory is fixed, and
+// renamed to the cache when it is finished.  It is read from a mapping.
+class CEventCache
+{
+  public:
+    CEventCache(void);
+    ~CEventCache(void);
+    static int makeFileName(const char *inputName, char *cacheName,
+      size_t size);
+  // Writing
+    int create(const char *cacheName, const char *inputName,
+      epicsUInt32 options);
+    int isWriting(void) const { return fp != NULL; }
+    void add(int id, const epicsTime &time);
+    int finish(const CNameTable &names, int linesSkipped,
+      const int lineCounts[FT_NFORMATS]);
+    void abandon(void);
+  // Reading
+    int open(const char *cacheName, const char *inputName,
+      epicsUInt32 options);
+    int isReading(void) const { return mappedFile.isOpen(); }
+    void close(void);
+    int getNameCount(void) const { return (int)header.nNames; }
+    const char *getNames(void) const { return names; }
+    int next(int *id, epicsTime *time);
+    int getLinesSkipped(void) const { return header.linesSkipped; }
+    int getLineCount(CaswFileType type) const {
+	return header.lineCounts[type];
+    }
+    const char *getErrorString(void) const { return errorString; }
+
+  private:
+    void flushBuffer(void);
+
+    CacheHeader header;
+    const char *errorString;
+    epicsInt64 lastKey;
+  // Writing
+    FILE *fp;
+    char cacheName[PATH_MAX];
+    char tempName[PATH_MAX];
+    unsigned char *buffer;
+    size_t bufferLen;
+    int writeError;
+  // Reading
+    CMappedFile mappedFile;
+    const unsigned char *cur;
+    const unsigned char *eventsEnd;
+    const char *names;
+};
+
+#endif // _INC_CEVENTCACHE_H
@@ -0,0 +1,162 @@
+// Implementation of the ring of events from the reader to a shard
+// worker for ParseCASW
+
+// Each side sets a waiting flag before it sleeps and then checks the
+// ring again.  The other side only signals when it finds the flag set
+// after publishing its index.  Setting and taking the flag are
+// compare-and-swaps, which are full memory barriers, so either the
+// sleeper sees the new index or the other side sees the flag, and no
+// wakeup is lost.  The flag costs one atomic instruction per record
+// instead of the event's mutex.  A signal that is no longer needed
+// only causes one extra pass of the loop that waits.
+
+#include <stdlib.h>
+
+#include <epicsAtomic.h>
+
+#include "parsecasw.h"
+#include "utils.h"
+#include "CEventRing.h"
+
+#define EVENT_RING_MASK (EVENT_RING_SIZE-1)
+
+// Class CEventRing implementations
+
+CEventRing::CEventRing(void) :
+    records(NULL),
+    event(NULL),
+    spaceEvent(NULL),
+    consumerWaiting(0),
+    producerWaiting(0),
+    tail(0),
+    maxDepth(0),
+    nPushed(0),
+    nDrops(0),
+    head(0)
+{
+    records=new RingRecord[EVENT_RING_SIZE];
+    if(!records) {
+	errMsg("Cannot allocate space for event ring");
+	exit(1);
+    }
+    event=epicsEventCreate(epicsEventEmpty);
+    spaceEvent=epicsEventCreate(epicsEventEmpty);
+    if(!event || !spaceEvent) {
+	errMsg("Cannot create events for event ring");
+	exit(1);
+    }
+}
+
+CEventRing::~CEventRing(void)
+{
+    if(records) delete [] records;
+    if(event) epicsEventDestroy(event);
+    if(spaceEvent) epicsEventDestroy(spaceEvent);
+}
+
+// Puts a record in the ring if there is room.  Returns 1 if it was put
+// or 0 if the ring is full.  Only called by the producer.
+int CEventRing::put(const RingRecord &record)
+{
+    size_t depth=tail-epicsAtomicGetSizeT(&head);
+    if(depth >= EVENT_RING_SIZE) return 0;
+
+  // The consumer is done with the slot once head has passed it
+    epicsAtomicReadMemoryBarrier();
+    records[tail&EVENT_RING_MASK]=record;
+    epicsAtomicWriteMemoryBarrier();
+    epicsAtomicSetSizeT(&tail,tail+1);
+
+    if(++depth > maxDepth) epicsAtomicSetSizeT(&maxDepth,depth);
+    if(epicsAtomicCmpAndSwapIntT(&consumerWaiting,1,0)) {
+	epicsEventSignal(event);
+    }
+
+    return 1;
+}
+
+// Pushes a record, dropping it if the ring is full.  Returns P_OK or
+// P_ERROR if it was dropped.
+int CEventRing::push(const RingRecord &record)
+{
+    if(put(record)) {
+	epicsAtomicSetSizeT(&nPushed,nPushed+1);
+	return P_OK;
+    }
+    epicsAtomicSetSizeT(&nDrops,nDrops+1);
+    return P_ERROR;
+}
+
+// Pushes a record that must not be dropped, sleeping until the consumer
+// frees a slot if the ring is full
+void CEventRing::pushWait(const RingRecord &record)
+{
+    while(!put(record)) {
+	epicsAtomicCmpAndSwapIntT(&producerWaiting,0,1);
+	if(tail-epicsAtomicGetSizeT(&head) < EVENT_RING_SIZE) {
+	    epicsAtomicSetIntT(&producerWaiting,0);
+	    continue;
+	}
+	epicsEventWait(spaceEvent);
+    }
+    if(record.type == RR_EVENT) epicsAtomicSetSizeT(&nPushed,nPushed+1);
+}
+
+// Takes the oldest record.  Returns 1 if there was one, else 0.  Only
+// called by the consumer.
+int CEventRing::pop(RingRecord &record)
+{
+    if(head == epicsAtomicGetSizeT(&tail)) return 0;
+
+    epicsAtomicReadMemoryBarrier();
+    record=records[head&EVENT_RING_MASK];
+  // Finish with the slot before the producer can reuse it
+    epicsAtomicWriteMemoryBarrier();
+    epicsAtomicSetSizeT(&head,head+1);
+    if(epicsAtomicCmpAndSwapIntT(&producerWaiting,1,0)) {
+	epicsEventSignal(spaceEvent);
+    }
+
+    return 1;
+}
+
+// Sleeps until a record is pushed or signal() is called.  Only called
+// by the consumer after pop() found the ring empty.
+void CEventRing::wait(void)
+{
+    epicsAtomicCmpAndSwapIntT(&consumerWaiting,0,1);
+    if(head != epicsAtomicGetSizeT(&tail)) {
+	epicsAtomicSetIntT(&consumerWaiting,0);
+	return;
+    }
+    epicsEventWait(event);
+}
+
+unsigned CEventRing::getDepth(void) const
+{
+    size_t curHead=epicsAtomicGetSizeT(&head);
+    return (unsigned)(epicsAtomicGetSizeT(&tail)-curHead);
+}
+
+unsigned CEventRing::getMaxDepth(void) const
+{
+    return (unsigned)epicsAtomicGetSizeT(&maxDepth);
+}
+
+unsigned CEventRing::getPushed(void) const
+{
+    return (unsigned)epicsAtomicGetSizeT(&nPushed);
+}
+
+unsigned CEventRing::getDrops(void) const
+{
+    return (unsigned)epicsAtomicGetSizeT(&nDrops);
+}
+
+// Prints one line with the counters
+void CEventRing::printStats(FILE *fp) const
+{
+    fprintf(fp,"Event ring: %u queued, %u max depth of %d, %u pushed, "
+      "%u dropped\n",getDepth(),getMaxDepth(),EVENT_RING_SIZE,
+      getPushed(),getDrops());
+}
@@ -0,0 +1,76 @@
+// Ring of events from the reader to a shard worker for ParseCASW
+
+#ifndef _INC_CEVENTRING_H
+#define _INC_CEVENTRING_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <epicsTime.h>
+#include <epicsEvent.h>
+
+// Number of records in the ring.  Must be a power of 2.
+#define EVENT_RING_SIZE 16384
+
+typedef enum _RingRecordType {
+    RR_EVENT,
+    RR_END
+} RingRecordType;
+
+// An event for a server, or the end of the input.  The name is from
+// the CNameTable, where it does not move.
+struct RingRecord
+{
+    epicsTime time;
+    const char *name;
+    int id;
+    int lineNum;
+    RingRecordType type;
+};
+
+// A bounded single-producer, single-consumer ring.  The reader pushes
+// and the shard worker pops, and neither takes a lock.  Each side
+// only writes its own index, and the memory barriers order the record
+// before the index that publishes or frees it.  The indexes count up
+// and are masked, so full and empty differ.  An event that does not
+// fit is dropped by push(), which -live uses, and waited for by
+// pushWait().
+// A side that has to sleep sets its waiting flag, and the other side
+// only signals its event then.  The consumer's event is also signalled
+// for report requests.
+class CEventRing
+{
+  public:
+    CEventRing(void);
+    ~CEventRing(void);
+    int push(const RingRecord &record);
+    void pushWait(const RingRecord &record);
+    int pop(RingRecord &record);
+    void wait(void);
+    void signal(void) { epicsEventSignal(event); }
+    unsigned getDepth(void) const;
+    unsigned getMaxDepth(void) const;
+  // The counts of events, not including the end
+    unsigned getPushed(void) const;
+    unsigned getDrops(void) const;
+    void printStats(FILE *fp) const;
+
+  private:
+    int put(const RingRecord &record);
+
+    RingRecord *records;
+    epicsEventId event;
+    epicsEventId spaceEvent;
+  // Set by the side that is about to sleep and taken by the other
+    int consumerWaiting;
+    int producerWaiting;
+  // Written by the producer
+    size_t tail;
+    size_t maxDepth;
+    size_t nPushed;
+    size_t nDrops;
+  // Written by the consumer
+    size_t head;
+};
+
+#endif // _INC_CEVENTRING_H
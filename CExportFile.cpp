@@ -0,0 +1,298 @@
+// Implementation of the binary columnar export of the groups for
+// ParseCASW
+
+// Each column is written from one array that is reused, so the export
+// takes one pass over the summaries per column and memory for only one
+// column.  The offsets of the columns follow from the counts in the
+// header, so the reader checks the header and the size of the file and
+// then only adds the offsets to the start of the mapping.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parsecasw.h"
+#include "utils.h"
+#include "CExportFile.h"
+
+// Alignment of the columns
+#define EXPORT_ALIGN 8
+
+// Sizes of the entries of the columns, in the order of ExportColumn,
+// with 0 for the names, whose size is in the header
+static const size_t columnSizes[EC_NCOLUMNS]={
+    sizeof(epicsUInt32),0,
+    sizeof(epicsInt64),sizeof(epicsInt64),
+    sizeof(epicsUInt32),sizeof(epicsUInt32),
+    sizeof(double),sizeof(double),sizeof(double),
+    sizeof(epicsInt32),sizeof(epicsInt64),sizeof(epicsInt64),
+    sizeof(epicsInt32),
+    sizeof(double),sizeof(double),sizeof(double),sizeof(double),
+    sizeof(double),sizeof(double),sizeof(double),
+    sizeof(epicsInt32),sizeof(epicsInt32),
+    sizeof(epicsUInt8),sizeof(epicsUInt8)
+};
+
+// Class CExportFile implementations
+
+CExportFile::CExportFile(void) :
+    errorString(NULL),
+    nServers(0),
+    nGroups(0),
+    nameOffsets(NULL),
+    names(NULL),
+    serverIds(NULL),
+    characterizations(NULL)
+{
+    for(int i=0; i <= EC_NCOLUMNS; i++) offsets[i]=0;
+}
+
+CExportFile::~CExportFile(void)
+{
+    close();
+}
+
+// Finds the offsets of the columns, and the size of the file as the
+// last one
+void CExportFile::layout(epicsUInt32 nServersIn, epicsUInt32 nGroupsIn,
+  epicsUInt32 namesSize, size_t offsetsOut[EC_NCOLUMNS+1])
+{
+    size_t offset=sizeof(ExportHeader);
+
+    for(int col=0; col < EC_NCOLUMNS; col++) {
+	offset=(offset+EXPORT_ALIGN-1)/EXPORT_ALIGN*EXPORT_ALIGN;
+	offsetsOut[col]=offset;
+	if(col == EC_NAMES) {
+	    offset+=namesSize;
+	} else if(col < EC_SERVER_ID) {
+	    offset+=columnSizes[col]*nServersIn;
+	} else {
+	    offset+=columnSizes[col]*nGroupsIn;
+	}
+    }
+    offsetsOut[EC_NCOLUMNS]=(offset+EXPORT_ALIGN-1)/EXPORT_ALIGN*EXPORT_ALIGN;
+}
+
+// Writes the servers, which are indexed by their ids in the names, and
+// the group summaries with their characterizations.  Returns P_OK or
+// P_ERROR.
+int CExportFile::write(const char *fileName, const CNameTable &nameTable,
+  const IocSummary *servers, int nGroupsIn, const GroupSummary *summaries,
+  const unsigned char *chns)
+{
+    ExportHeader header;
+    size_t colOffsets[EC_NCOLUMNS+1];
+    static const char zeros[EXPORT_ALIGN]={0};
+    int nServersIn=nameTable.count();
+    int i;
+
+    errorString=NULL;
+    memset(&header,0,sizeof(header));
+    initFileHeader(header.file,EXPORT_MAGIC,EXPORT_VERSION);
+    header.nServers=(epicsUInt32)nServersIn;
+    header.nGroups=(epicsUInt32)nGroupsIn;
+    size_t namesSize=0;
+    for(i=0; i < nServersIn; i++) namesSize+=nameTable.getLength(i)+1;
+    header.namesSize=(epicsUInt32)namesSize;
+    layout(header.nServers,header.nGroups,header.namesSize,colOffsets);
+
+  // The array for one column of numbers
+    int maxEntries=(nServersIn > nGroupsIn)?nServersIn:nGroupsIn;
+    char *buf=new char[EXPORT_ALIGN*(maxEntries+1)];
+    if(!buf) {
+	errMsg("Cannot allocate space for export column");
+	exit(1);
+    }
+
+    FILE *fp=fopen(fileName,"wb");
+    if(!fp) {
+	errorString="Cannot open file";
+	delete [] buf;
+	return P_ERROR;
+    }
+
+    int ok=fwrite(&header,sizeof(header),1,fp) == 1;
+    size_t offset=sizeof(header);
+    for(int col=0; ok && col < EC_NCOLUMNS; col++) {
+	if(colOffsets[col] > offset) {
+	    ok=fwrite(zeros,colOffsets[col]-offset,1,fp) == 1;
+	    offset=colOffsets[col];
+	    if(!ok) break;
+	}
+	size_t size;
+	if(col == EC_NAMES) {
+	  // The names are written as they are, each with its NUL
+	    for(i=0; ok && i < nServersIn; i++) {
+		ok=fwrite(nameTable.getName(i),nameTable.getLength(i)+1,1,
+		  fp) == 1;
+	    }
+	    offset+=namesSize;
+	    continue;
+	}
+	int n=(col < EC_SERVER_ID)?nServersIn:nGroupsIn;
+	size=columnSizes[col]*n;
+	epicsUInt32 *u32=(epicsUInt32 *)buf;
+	epicsInt32 *i32=(epicsInt32 *)buf;
+	epicsInt64 *i64=(epicsInt64 *)buf;
+	double *d=(double *)buf;
+	epicsUInt8 *u8=(epicsUInt8 *)buf;
+	epicsUInt32 nameOffset=0;
+	for(i=0; i < n; i++) {
+	    const IocSummary *pIoc=(col < EC_SERVER_ID)?servers+i:NULL;
+	    const GroupSummary *pGroup=(col < EC_SERVER_ID)?NULL:summaries+i;
+	    switch(col) {
+	    case EC_NAME_OFFSETS:
+		u32[i]=nameOffset;
+		nameOffset+=(epicsUInt32)nameTable.getLength(i)+1;
+		break;
+	    case EC_SERVER_FIRST: i64[i]=timeToNs(pIoc->firstTime); break;
+	    case EC_SERVER_LAST: i64[i]=timeToNs(pIoc->lastTime); break;
+	    case EC_SERVER_INTERVALS: u32[i]=pIoc->nIntervals; break;
+	    case EC_SERVER_GROUPS: u32[i]=pIoc->nGroups; break;
+	    case EC_SERVER_P50: d[i]=pIoc->p50; break;
+	    case EC_SERVER_P90: d[i]=pIoc->p90; break;
+	    case EC_SERVER_P99: d[i]=pIoc->p99; break;
+	    case EC_SERVER_ID: i32[i]=pGroup->iocId; break;
+	    case EC_FIRST: i64[i]=timeToNs(pGroup->firstTime); break;
+	    case EC_LAST: i64[i]=timeToNs(pGroup->lastTime); break;
+	    case EC_POINTS: i32[i]=pGroup->nIntervals+1; break;
+	    case EC_MEAN: d[i]=pGroup->mean; break;
+	    case EC_SIGMA: d[i]=pGroup->sigma; break;
+	    case EC_MIN: d[i]=pGroup->min; break;
+	    case EC_MAX: d[i]=pGroup->max; break;
+	    case EC_P50: d[i]=pGroup->p50; break;
+	    case EC_P90: d[i]=pGroup->p90; break;
+	    case EC_P99: d[i]=pGroup->p99; break;
+	    case EC_INCREASING: i32[i]=pGroup->increasing; break;
+	    case EC_OUT_OF_ORDER: i32[i]=pGroup->outOfOrder; break;
+	    case EC_INTERVAL_TYPE: u8[i]=pGroup->intervalType; break;
+	    case EC_CHARACTERIZATION: u8[i]=chns[i]; break;
+	    }
+	}
+	if(size > 0) ok=fwrite(buf,size,1,fp) == 1;
+	offset+=size;
+    }
+    if(ok && colOffsets[EC_NCOLUMNS] > offset) {
+	ok=fwrite(zeros,colOffsets[EC_NCOLUMNS]-offset,1,fp) == 1;
+    }
+    if(fclose(fp)) ok=0;
+    delete [] buf;
+    if(!ok) {
+	errorString="Error writing file";
+	return P_ERROR;
+    }
+
+    return P_OK;
+}
+
+// Maps an export file and checks it.  Returns P_OK or P_ERROR.
+int CExportFile::open(const char *fileName)
+{
+    close();
+    if(mappedFile.open(fileName) != P_OK) {
+	errorString="Cannot map file";
+	return P_ERROR;
+    }
+    if(mappedFile.getSize() < sizeof(ExportHeader)) {
+	errorString="Not an export file";
+	close();
+	return P_ERROR;
+    }
+    const ExportHeader *pHeader=(const ExportHeader *)mappedFile.getBegin();
+    errorString=checkFileHeader(pHeader->file,EXPORT_MAGIC,EXPORT_VERSION);
+    if(errorString) {
+	close();
+	return P_ERROR;
+    }
+    layout(pHeader->nServers,pHeader->nGroups,pHeader->namesSize,offsets);
+    if(offsets[EC_NCOLUMNS] != mappedFile.getSize()) {
+	errorString="Export file is the wrong size";
+	close();
+	return P_ERROR;
+    }
+
+    nServers=(int)pHeader->nServers;
+    nGroups=(int)pHeader->nGroups;
+    nameOffsets=(const epicsUInt32 *)column(EC_NAME_OFFSETS);
+    names=(const char *)column(EC_NAMES);
+    serverIds=(const epicsInt32 *)column(EC_SERVER_ID);
+    characterizations=(const epicsUInt8 *)column(EC_CHARACTERIZATION);
+
+  // Check what is used as an index, so a damaged file cannot cause a
+  // reference outside the mapping
+    if(pHeader->namesSize > 0 && names[pHeader->namesSize-1] != '\0') {
+	errorString="Export file has bad names";
+	close();
+	return P_ERROR;
+    }
+    for(int i=0; i < nServers; i++) {
+	if(nameOffsets[i] >= pHeader->namesSize) {
+	    errorString="Export file has bad names";
+	    close();
+	    return P_ERROR;
+	}
+    }
+    for(int i=0; i < nGroups; i++) {
+	if(serverIds[i] < 0 || serverIds[i] >= nServers) {
+	    errorString="Export file has bad server ids";
+	    close();
+	    return P_ERROR;
+	}
+    }
+    const epicsInt32 *points=(const epicsInt32 *)column(EC_POINTS);
+    const epicsUInt8 *intervalTypes=
+      (const epicsUInt8 *)column(EC_INTERVAL_TYPE);
+    for(int i=0; i < nGroups; i++) {
+	if(points[i] < 1 || intervalTypes[i] > MonotonicDecreasing) {
+	    errorString="Export file has bad groups";
+	    close();
+	    return P_ERROR;
+	}
+    }
+
+    return P_OK;
+}
+
+void CExportFile::close(void)
+{
+    mappedFile.close();
+    nServers=nGroups=0;
+    nameOffsets=NULL;
+    names=NULL;
+    serverIds=NULL;
+    characterizations=NULL;
+}
+
+// Gets the summary of a server
+void CExportFile::getIoc(int server, IocSummary &summary) const
+{
+    nsToTime(((const epicsInt64 *)column(EC_SERVER_FIRST))[server],
+      summary.firstTime);
+    nsToTime(((const epicsInt64 *)column(EC_SERVER_LAST))[server],
+      summary.lastTime);
+    summary.nIntervals=((const epicsUInt32 *)
+      column(EC_SERVER_INTERVALS))[server];
+    summary.nGroups=((const epicsUInt32 *)column(EC_SERVER_GROUPS))[server];
+    summary.p50=((const double *)column(EC_SERVER_P50))[server];
+    summary.p90=((const double *)column(EC_SERVER_P90))[server];
+    summary.p99=((const double *)column(EC_SERVER_P99))[server];
+}
+
+// Gets the summary of a group
+void CExportFile::getGroup(int i, GroupSummary &summary) const
+{
+    nsToTime(((const epicsInt64 *)column(EC_FIRST))[i],summary.firstTime);
+    nsToTime(((const epicsInt64 *)column(EC_LAST))[i],summary.lastTime);
+    summary.mean=((const double *)column(EC_MEAN))[i];
+    summary.sigma=((const double *)column(EC_SIGMA))[i];
+    summary.min=((const double *)column(EC_MIN))[i];
+    summary.max=((const double *)column(EC_MAX))[i];
+    summary.p50=((const double *)column(EC_P50))[i];
+    summary.p90=((const double *)column(EC_P90))[i];
+    summary.p99=((const double *)column(EC_P99))[i];
+    summary.iocId=serverIds[i];
+    summary.nIntervals=((const epicsInt32 *)column(EC_POINTS))[i]-1;
+    summary.increasing=((const epicsInt32 *)column(EC_INCREASING))[i];
+    summary.outOfOrder=((const epicsInt32 *)column(EC_OUT_OF_ORDER))[i];
+    summary.intervalType=((const epicsUInt8 *)column(EC_INTERVAL_TYPE))[i];
+}
@@ -0,0 +1,105 @@
+// Binary columnar export of the groups for ParseCASW
+
+#ifndef _INC_CEXPORTFILE_H
+#define _INC_CEXPORTFILE_H
+
+#include <stddef.h>
+
+#include <epicsTypes.h>
+
+#include "utils.h"
+#include "CMappedFile.h"
+#include "CNameTable.h"
+#include "CIoc.h"
+#include "CSummaryStore.h"
+
+#define EXPORT_MAGIC "PCASWEX"
+#define EXPORT_VERSION 1
+
+// The columns in the order they are in the file, after the header.
+// Each starts on a multiple of 8 bytes.  The name offsets, names, and
+// server columns have an entry per server id, and the group columns an
+// entry per group, in the order of the report by group.  The times are
+// integer nanoseconds since the EPICS epoch.
+typedef enum _ExportColumn {
+    EC_NAME_OFFSETS,	// epicsUInt32 offset of the name in EC_NAMES
+    EC_NAMES,		// NUL-terminated names
+    EC_SERVER_FIRST,	// epicsInt64 time of the first event
+    EC_SERVER_LAST,	// epicsInt64 time of the last event
+    EC_SERVER_INTERVALS,// epicsUInt32 number of intervals
+    EC_SERVER_GROUPS,	// epicsUInt32 number of groups
+    EC_SERVER_P50,	// double percentiles of the intervals in sec
+    EC_SERVER_P90,
+    EC_SERVER_P99,
+    EC_SERVER_ID,	// epicsInt32 server id of the group
+    EC_FIRST,		// epicsInt64 time of the first event
+    EC_LAST,		// epicsInt64 time of the last event
+    EC_POINTS,		// epicsInt32 number of events
+    EC_MEAN,		// double statistics of the intervals in sec
+    EC_SIGMA,
+    EC_MIN,
+    EC_MAX,
+    EC_P50,
+    EC_P90,
+    EC_P99,
+    EC_INCREASING,	// epicsInt32 number of increasing intervals
+    EC_OUT_OF_ORDER,	// epicsInt32 number of events out of order
+    EC_INTERVAL_TYPE,	// epicsUInt8 IntervalType
+    EC_CHARACTERIZATION,// epicsUInt8 characterization
+    EC_NCOLUMNS
+} ExportColumn;
+
+struct ExportHeader
+{
+    FileHeader file;
+    epicsUInt32 nServers;
+    epicsUInt32 nGroups;
+    epicsUInt32 namesSize;
+    epicsUInt32 reserved;
+};
+
+// An export file.  write() makes one from the servers and the groups,
+// and open() maps one, after which the columns are used in place in
+// the mapping with no copy.  The group summaries that are got from it
+// are the same as those that were written, except for next.
+class CExportFile
+{
+  public:
+    CExportFile(void);
+    ~CExportFile(void);
+    int write(const char *fileName, const CNameTable &names,
+      const IocSummary *servers, int nGroups, const GroupSummary *summaries,
+      const unsigned char *characterizations);
+    int open(const char *fileName);
+    void close(void);
+    const char *getErrorString(void) const { return errorString; }
+    int getServerCount(void) const { return nServers; }
+    int getGroupCount(void) const { return nGroups; }
+    const char *getName(int server) const {
+	return names+nameOffsets[server];
+    }
+    void getIoc(int server, IocSummary &summary) const;
+    int getServer(int i) const { return serverIds[i]; }
+    void getGroup(int i, GroupSummary &summary) const;
+    int getCharacterization(int i) const { return characterizations[i]; }
+
+  private:
+    static void layout(epicsUInt32 nServers, epicsUInt32 nGroups,
+      epicsUInt32 namesSize, size_t offsets[EC_NCOLUMNS+1]);
+    const void *column(ExportColumn col) const {
+	return mappedFile.getBegin()+offsets[col];
+    }
+
+    CMappedFile mappedFile;
+    const char *errorString;
+    int nServers;
+    int nGroups;
+    size_t offsets[EC_NCOLUMNS+1];
+  // The columns that are used the most
+    const epicsUInt32 *nameOffsets;
+    const char *names;
+    const epicsInt32 *serverIds;
+    const epicsUInt8 *characterizations;
+};
+
+#endif // _INC_CEXPORTFILE_H
@@ -0,0 +1,331 @@
+// Implementation of input files that are parsed by their own threads
+// and merged in time order for ParseCASW
+
+// Each file is read and parsed by its own thread, which also converts
+// the times and hashes the names.  The lines are passed to the merge in
+// batches of events through a ring of SOURCE_NBATCHES batches, so the
+// locking is per batch, not per line.  The merge takes the event with
+// the earliest time from the heap of sources and then advances that
+// source.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <epicsThread.h>
+
+#include "utils.h"
+#include "CNameTable.h"
+#include "CFileSource.h"
+
+static void sourceThread(void *arg);
+
+// Class CFileSource implementations
+
+CFileSource::CFileSource(int indexIn, CaswFileType fileTypeIn,
+  const CTimeCache &timeCacheIn, const CNameFilter &nameFilterIn) :
+    index(indexIn),
+    fileType(fileTypeIn),
+    timeCache(timeCacheIn),
+    nameFilter(nameFilterIn),
+    fileName(NULL),
+    linesSkipped(0),
+    linesFiltered(0),
+    status(P_OK),
+    errorString(NULL),
+    threadStarted(0),
+    lock(NULL),
+    fullEvent(NULL),
+    freeEvent(NULL),
+    exitEvent(NULL),
+    head(0),
+    nFull(0),
+    done(0),
+    stop(0),
+    cur(0),
+    haveBatch(0),
+    fill(-1),
+    fillCount(0),
+    fillText(0)
+{
+    for(int i=0; i < SOURCE_NBATCHES; i++) {
+	events[i]=NULL;
+	text[i]=NULL;
+	textSizes[i]=0;
+	counts[i]=0;
+    }
+    for(int i=0; i < FT_NFORMATS; i++) lineCounts[i]=0;
+}
+
+CFileSource::~CFileSource(void)
+{
+  // Stop the thread if it is still running
+    if(threadStarted) {
+	epicsMutexLock(lock);
+	stop=1;
+	epicsMutexUnlock(lock);
+	epicsEventSignal(freeEvent);
+	epicsEventWait(exitEvent);
+    }
+    if(lock) epicsMutexDestroy(lock);
+    if(fullEvent) epicsEventDestroy(fullEvent);
+    if(freeEvent) epicsEventDestroy(freeEvent);
+    if(exitEvent) epicsEventDestroy(exitEvent);
+    for(int i=0; i < SOURCE_NBATCHES; i++) {
+	if(events[i]) delete [] events[i];
+	if(text[i]) delete [] text[i];
+    }
+}
+
+// Opens the file, which is decompressed if it is compressed.  Returns
+// P_OK or P_ERROR, in which case getErrorString() tells why.
+int CFileSource::open(const char *fileNameIn)
+{
+    fileName=fileNameIn;
+    if(lineReader.open(fileName) != P_OK) {
+	errorString=lineReader.getErrorString();
+	return P_ERROR;
+    }
+    return P_OK;
+}
+
+// Starts the parse thread.  Returns P_OK or P_ERROR.
+int CFileSource::start(void)
+{
+    for(int i=0; i < SOURCE_NBATCHES; i++) {
+	events[i]=new CaswEvent[SOURCE_BATCH_EVENTS];
+	text[i]=new char[SOURCE_BATCH_TEXT];
+	textSizes[i]=SOURCE_BATCH_TEXT;
+	if(!events[i] || !text[i]) {
+	    errMsg("Cannot allocate space for event batches");
+	    exit(1);
+	}
+    }
+
+    lock=epicsMutexCreate();
+    fullEvent=epicsEventCreate(epicsEventEmpty);
+    freeEvent=epicsEventCreate(epicsEventEmpty);
+    exitEvent=epicsEventCreate(epicsEventEmpty);
+    if(!lock || !fullEvent || !freeEvent || !exitEvent) return P_ERROR;
+    epicsThreadId tid=epicsThreadCreate("parsecaswSource",
+      epicsThreadPriorityMedium,
+      epicsThreadGetStackSize(epicsThreadStackMedium),
+      sourceThread,this);
+    if(!tid) return P_ERROR;
+    threadStarted=1;
+
+    return P_OK;
+}
+
+// The parse thread
+void CFileSource::run(void)
+{
+    const char *start,*end;
+    int lineNum=0;
+
+    while(lineReader.getLine(&start,&end)) {
+	if(addLine(start,end,++lineNum) != P_OK) break;
+    }
+    if(lineReader.getStatus() != P_OK) {
+	status=P_ERROR;
+	errorString=lineReader.getErrorString();
+    }
+    lineReader.close();
+
+  // Pass on the last batch
+    publish();
+
+    epicsMutexLock(lock);
+    done=1;
+    epicsMutexUnlock(lock);
+    epicsEventSignal(fullEvent);
+    epicsEventSignal(exitEvent);
+}
+
+// Parses a line and adds it to the batch being filled.  Returns P_OK,
+// or P_ERROR if the thread is being stopped.
+int CFileSource::addLine(const char *start, const char *end, int lineNum)
+{
+    CaswLine caswLine;
+    epicsTime time;
+    size_t len=(size_t)(end-start);
+
+    if(parseLine(start,end,fileType,&caswLine) != P_OK) {
+	linesSkipped++;
+	return P_OK;
+    }
+    if(timeCache.getTime(&caswLine,&time) != P_OK) {
+	linesSkipped++;
+	return P_OK;
+    }
+    if(!nameFilter.accepts(caswLine.name,caswLine.nameLen)) {
+	linesFiltered++;
+	return P_OK;
+    }
+    lineCounts[caswLine.fileType]++;
+
+  // Pass on the batch if it is full
+    if(fill >= 0 && (fillCount >= SOURCE_BATCH_EVENTS ||
+	 fillText+len > textSizes[fill])) {
+	publish();
+    }
+
+  // Wait for a free batch
+    if(fill < 0) {
+	epicsMutexLock(lock);
+	while(nFull >= SOURCE_NBATCHES && !stop) {
+	    epicsMutexUnlock(lock);
+	    epicsEventWait(freeEvent);
+	    epicsMutexLock(lock);
+	}
+	if(stop) {
+	    epicsMutexUnlock(lock);
+	    return P_ERROR;
+	}
+	fill=(head+nFull)%SOURCE_NBATCHES;
+	epicsMutexUnlock(lock);
+	fillCount=0;
+	fillText=0;
+
+      // Make room for a long line.  The merge is not using this batch.
+	if(len > textSizes[fill]) {
+	    delete [] text[fill];
+	    text[fill]=new char[len];
+	    if(!text[fill]) {
+		errMsg("Cannot allocate space for event batch text");
+		exit(1);
+	    }
+	    textSizes[fill]=len;
+	}
+    }
+
+    CaswEvent *pEvent=&events[fill][fillCount++];
+    memcpy(text[fill]+fillText,start,len);
+    pEvent->time=time;
+    pEvent->hash=CNameTable::hash(caswLine.name,caswLine.nameLen);
+    pEvent->lineNum=lineNum;
+    pEvent->lineOffset=fillText;
+    pEvent->lineLen=len;
+    pEvent->nameOffset=fillText+(size_t)(caswLine.name-start);
+    pEvent->nameLen=caswLine.nameLen;
+    fillText+=len;
+
+    return P_OK;
+}
+
+// Passes the batch being filled to the merge
+void CFileSource::publish(void)
+{
+    if(fill < 0) return;
+
+    epicsMutexLock(lock);
+    counts[fill]=fillCount;
+    nFull++;
+    epicsMutexUnlock(lock);
+    epicsEventSignal(fullEvent);
+    fill=-1;
+}
+
+// Advances to the next event, waiting for the parse thread if
+// necessary.  Returns 0 if there are no more.
+int CFileSource::next(void)
+{
+    if(haveBatch && cur+1 < counts[head]) {
+	cur++;
+	return 1;
+    }
+    if(!threadStarted) return 0;
+
+    epicsMutexLock(lock);
+    if(haveBatch) {
+	head=(head+1)%SOURCE_NBATCHES;
+	nFull--;
+	haveBatch=0;
+	epicsMutexUnlock(lock);
+	epicsEventSignal(freeEvent);
+	epicsMutexLock(lock);
+    }
+    while(!nFull && !done) {
+	epicsMutexUnlock(lock);
+	epicsEventWait(fullEvent);
+	epicsMutexLock(lock);
+    }
+    if(!nFull) {
+	epicsMutexUnlock(lock);
+	return 0;
+    }
+    haveBatch=1;
+    cur=0;
+    epicsMutexUnlock(lock);
+
+    return 1;
+}
+
+static void sourceThread(void *arg)
+{
+    CFileSource *pSource=(CFileSource *)arg;
+
+    pSource->run();
+}
+
+// Class CMergeHeap implementations
+
+CMergeHeap::CMergeHeap(int sizeIn) :
+    sources(NULL),
+    nSources(0),
+    size(sizeIn)
+{
+    sources=new CFileSource *[size];
+    if(!sources) {
+	errMsg("Cannot allocate space for merge heap");
+	exit(1);
+    }
+}
+
+CMergeHeap::~CMergeHeap(void)
+{
+    if(sources) delete [] sources;
+}
+
+void CMergeHeap::push(CFileSource *pSource)
+{
+    int i=nSources++;
+
+    while(i > 0) {
+	int parent=(i-1)/2;
+	if(!before(pSource,sources[parent])) break;
+	sources[i]=sources[parent];
+	i=parent;
+    }
+    sources[i]=pSource;
+}
+
+// Removes the top source
+void CMergeHeap::pop(void)
+{
+    if(!nSources) return;
+    sources[0]=sources[--nSources];
+    siftDown(0);
+}
+
+// Restores the order after the top source has advanced
+void CMergeHeap::replaceTop(void)
+{
+    siftDown(0);
+}
+
+void CMergeHeap::siftDown(int i)
+{
+    CFileSource *pSource=sources[i];
+
+    while(1) {
+	int child=2*i+1;
+	if(child >= nSources) break;
+	if(child+1 < nSources && before(sources[child+1],sources[child])) {
+	    child++;
+	}
+	if(!before(sources[child],pSource)) break;
+	sources[i]=sources[child];
+	i=child;
+    }
+    sources[i]=pSource;
+}
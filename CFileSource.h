@@ -0,0 +1,139 @@
+// Input files that are parsed by their own threads and merged in time
+// order for ParseCASW
+
+#ifndef _INC_CFILESOURCE_H
+#define _INC_CFILESOURCE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <epicsTime.h>
+#include <epicsMutex.h>
+#include <epicsEvent.h>
+
+#include "parsecasw.h"
+#include "parseLine.h"
+#include "CLineReader.h"
+#include "CNameFilter.h"
+
+// Number of batches between the parse thread and the merge
+#define SOURCE_NBATCHES 4
+// Maximum number of events in a batch
+#define SOURCE_BATCH_EVENTS 4096
+// Initial size of the text of the lines in a batch.  It grows for a
+// longer line.
+#define SOURCE_BATCH_TEXT (SOURCE_BATCH_EVENTS*64)
+
+// A parsed line.  The offsets are into the text of its batch.
+struct CaswEvent
+{
+    epicsTime time;
+    unsigned hash;
+    int lineNum;
+    size_t lineOffset;
+    size_t lineLen;
+    size_t nameOffset;
+    size_t nameLen;
+};
+
+// One input file.  It is opened by open(), and start() starts a thread
+// that parses the lines into batches of events.  The merge steps
+// through the events with next().
+class CFileSource
+{
+  public:
+    CFileSource(int index, CaswFileType fileType,
+      const CTimeCache &timeCache, const CNameFilter &nameFilter);
+    ~CFileSource(void);
+    int open(const char *fileName);
+    int start(void);
+    void run(void);
+    int next(void);
+    int getIndex(void) const { return index; }
+    const CaswEvent &getEvent(void) const { return events[head][cur]; }
+    const epicsTime &getTime(void) const { return events[head][cur].time; }
+    const char *getLine(void) const {
+	return text[head]+events[head][cur].lineOffset;
+    }
+    const char *getName(void) const {
+	return text[head]+events[head][cur].nameOffset;
+    }
+    const char *getFileName(void) const { return fileName; }
+    int getLinesSkipped(void) const { return linesSkipped; }
+    int getLinesFiltered(void) const { return linesFiltered; }
+    int getLineCount(CaswFileType type) const { return lineCounts[type]; }
+    int getStatus(void) const { return status; }
+    const char *getErrorString(void) const { return errorString; }
+
+  private:
+    int addLine(const char *start, const char *end, int lineNum);
+    void publish(void);
+
+    int index;
+    CaswFileType fileType;
+    CTimeCache timeCache;
+    const CNameFilter &nameFilter;
+    const char *fileName;
+    CLineReader lineReader;
+    int linesSkipped;
+    int linesFiltered;
+    int lineCounts[FT_NFORMATS];
+    int status;
+    const char *errorString;
+    int threadStarted;
+
+  // Shared with the parse thread
+    epicsMutexId lock;
+    epicsEventId fullEvent;
+    epicsEventId freeEvent;
+    epicsEventId exitEvent;
+    CaswEvent *events[SOURCE_NBATCHES];
+    char *text[SOURCE_NBATCHES];
+    size_t textSizes[SOURCE_NBATCHES];
+    int counts[SOURCE_NBATCHES];
+    int head;
+    int nFull;
+    int done;
+    int stop;
+
+  // Merge state
+    int cur;
+    int haveBatch;
+
+  // Parse thread state
+    int fill;
+    int fillCount;
+    size_t fillText;
+};
+
+// A binary heap of the sources ordered by the time of their current
+// event, then by their index, so that equal times are taken in the
+// order the files were given
+class CMergeHeap
+{
+  public:
+    CMergeHeap(int size);
+    ~CMergeHeap(void);
+    void push(CFileSource *pSource);
+    CFileSource *top(void) const { return nSources?sources[0]:NULL; }
+    void pop(void);
+    void replaceTop(void);
+    int count(void) const { return nSources; }
+
+  private:
+    int before(const CFileSource *p1, const CFileSource *p2) const;
+    void siftDown(int i);
+    CFileSource **sources;
+    int nSources;
+    int size;
+};
+
+inline int CMergeHeap::before(const CFileSource *p1,
+  const CFileSource *p2) const
+{
+    if(p1->getTime() < p2->getTime()) return 1;
+    if(p2->getTime() < p1->getTime()) return 0;
+    return p1->getIndex() < p2->getIndex();
+}
+
+#endif // _INC_CFILESOURCE_H
@@ -0,0 +1,446 @@
+// Implementation of the store of groups for ParseCASW
+
+// A group is a row across the arrays.  The running statistics are
+// updated the same way as when each group was its own object, so the
+// results are the same.  The free list of removed ids is linked
+// through the next array.
+
+// The deadline heap is only used in real-time mode, where the timer
+// reports the finished groups and removes them.  Only the entries at
+// the top whose times are more than newGroupTime ago are looked at, so
+// a tick costs in proportion to the groups that are finished or have
+// had events since they were queued, not to all the open groups.  A
+// removed group keeps GROUP_QUEUED while its entry is in the heap, so
+// a group that reuses its id is not queued twice.
+
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <new>
+
+#include <epicsStdio.h>
+
+#include "utils.h"
+#include "CGroupStore.h"
+#include "CIoc.h"
+
+// Initial number of groups, which doubles as needed
+#define GROUP_STORE_SIZE 256
+// Initial size of the heap and finished list, which double as needed
+#define GROUP_HEAP_SIZE 256
+
+// Replaces an array with a larger one holding the same first n values
+template <class T>
+static void growArray(T *&array, int n, int newSize)
+{
+    T *newArray=new T[newSize];
+    if(!newArray) {
+	errMsg("Cannot allocate space for group store");
+	exit(1);
+    }
+    for(int i=0; i < n; i++) newArray[i]=array[i];
+    if(array) delete [] array;
+    array=newArray;
+}
+
+// Class CGroupStore implementations
+
+CGroupStore::CGroupStore(void) :
+    iocPool("Server",sizeof(CIoc)),
+    sketchPool("Sketch",sizeof(CSketch)),
+    size(0),
+    capacity(0),
+    nUsed(0),
+    highWater(0),
+    nSketches(0),
+    sketchBytes(0),
+    freeList(-1),
+    deadlines(0),
+    heapGroups(NULL),
+    heapTimes(NULL),
+    nHeap(0),
+    heapSize(0),
+    finishedList(NULL),
+    nFinished(0),
+    finishedSize(0),
+    flags(NULL),
+    intervalTypes(NULL),
+    iocIds(NULL),
+    nexts(NULL),
+    prevs(NULL),
+    firstTimes(NULL),
+    lastTimes(NULL),
+    nIntervals(NULL),
+    sums(NULL),
+    sum2s(NULL),
+    maxs(NULL),
+    mins(NULL),
+    lastIntervals(NULL),
+    increasings(NULL),
+    outOfOrders(NULL),
+    sketches(NULL)
+{
+}
+
+CGroupStore::~CGroupStore(void)
+{
+    for(int group=0; group < size; group++) {
+	if(flags[group]&GROUP_USED) freeSketch(group);
+    }
+    if(flags) delete [] flags;
+    if(intervalTypes) delete [] intervalTypes;
+    if(iocIds) delete [] iocIds;
+    if(nexts) delete [] nexts;
+    if(prevs) delete [] prevs;
+    if(firstTimes) delete [] firstTimes;
+    if(lastTimes) delete [] lastTimes;
+    if(nIntervals) delete [] nIntervals;
+    if(sums) delete [] sums;
+    if(sum2s) delete [] sum2s;
+    if(maxs) delete [] maxs;
+    if(mins) delete [] mins;
+    if(lastIntervals) delete [] lastIntervals;
+    if(increasings) delete [] increasings;
+    if(outOfOrders) delete [] outOfOrders;
+    if(sketches) delete [] sketches;
+    if(heapGroups) delete [] heapGroups;
+    if(heapTimes) delete [] heapTimes;
+    if(finishedList) delete [] finishedList;
+}
+
+// Doubles the capacity of all the arrays
+void CGroupStore::grow(void)
+{
+    int newCapacity=capacity?2*capacity:GROUP_STORE_SIZE;
+
+    growArray(flags,size,newCapacity);
+    growArray(intervalTypes,size,newCapacity);
+    growArray(iocIds,size,newCapacity);
+    growArray(nexts,size,newCapacity);
+    growArray(prevs,size,newCapacity);
+    growArray(firstTimes,size,newCapacity);
+    growArray(lastTimes,size,newCapacity);
+    growArray(nIntervals,size,newCapacity);
+    growArray(sums,size,newCapacity);
+    growArray(sum2s,size,newCapacity);
+    growArray(maxs,size,newCapacity);
+    growArray(mins,size,newCapacity);
+    growArray(lastIntervals,size,newCapacity);
+    growArray(increasings,size,newCapacity);
+    growArray(outOfOrders,size,newCapacity);
+    growArray(sketches,size,newCapacity);
+    capacity=newCapacity;
+}
+
+// Returns an unused id, reusing a removed one if there is one
+int CGroupStore::allocate(void)
+{
+    int group;
+
+    if(freeList >= 0) {
+	group=freeList;
+	freeList=nexts[group];
+    } else {
+	if(size >= capacity) grow();
+	group=size++;
+	flags[group]=0;
+    }
+    if(++nUsed > highWater) highWater=nUsed;
+
+    return group;
+}
+
+// Adds a group with one event for a server and returns its id.  It is
+// not linked to the other groups of the server.
+int CGroupStore::add(int iocId, const epicsTime &time)
+{
+    int group=allocate();
+
+    flags[group]=(flags[group]&GROUP_QUEUED)|GROUP_USED;
+    intervalTypes[group]=NoIntervals;
+    iocIds[group]=iocId;
+    nexts[group]=-1;
+    prevs[group]=-1;
+    firstTimes[group]=time;
+    lastTimes[group]=time;
+    nIntervals[group]=0;
+    sums[group]=0.0;
+    sum2s[group]=0.0;
+    maxs[group]=DBL_MIN;
+    mins[group]=DBL_MAX;
+    lastIntervals[group]=0.0;
+    increasings[group]=0;
+    outOfOrders[group]=0;
+    sketches[group]=NULL;
+    if(deadlines && !(flags[group]&GROUP_QUEUED)) push(group);
+
+    return group;
+}
+
+// Adds a copy of a group from another store for a server and returns
+// its id.  It is not linked to the other groups of the server.
+int CGroupStore::copy(const CGroupStore &store, int groupIn, int iocId)
+{
+    int group=allocate();
+
+    flags[group]=(flags[group]&GROUP_QUEUED)|
+      (store.flags[groupIn]&~GROUP_QUEUED);
+    intervalTypes[group]=store.intervalTypes[groupIn];
+    iocIds[group]=iocId;
+    nexts[group]=-1;
+    prevs[group]=-1;
+    firstTimes[group]=store.firstTimes[groupIn];
+    lastTimes[group]=store.lastTimes[groupIn];
+    nIntervals[group]=store.nIntervals[groupIn];
+    sums[group]=store.sums[groupIn];
+    sum2s[group]=store.sum2s[groupIn];
+    maxs[group]=store.maxs[groupIn];
+    mins[group]=store.mins[groupIn];
+    lastIntervals[group]=store.lastIntervals[groupIn];
+    increasings[group]=store.increasings[groupIn];
+    outOfOrders[group]=store.outOfOrders[groupIn];
+    sketches[group]=NULL;
+    if(store.sketches[groupIn]) {
+	sketches[group]=new(sketchPool.allocate())
+	  CSketch(*store.sketches[groupIn]);
+	nSketches++;
+	sketchBytes+=sketches[group]->getExtraBytes();
+    }
+    if(deadlines) {
+	if(flags[group]&GROUP_FINISHED) addFinished(group);
+	else if(!(flags[group]&GROUP_QUEUED)) push(group);
+    }
+
+    return group;
+}
+
+// Removes a group that has been unlinked from its server.  Its id will
+// be reused.
+void CGroupStore::remove(int group)
+{
+    freeSketch(group);
+    flags[group]&=GROUP_QUEUED;
+    nexts[group]=freeList;
+    freeList=group;
+    nUsed--;
+}
+
+double CGroupStore::getMean(int group) const
+{
+    if(nIntervals[group] > 0) {
+	double avg=sums[group]/(double)nIntervals[group];
+	return avg;
+    } else {
+	return 0;
+    }
+}
+
+double CGroupStore::getSigma(int group) const
+{
+  // Use sigma=sqrt(sum(x-xbar)^2/n), not n-1 version
+    if(nIntervals[group] > 1) {
+	double avg=sums[group]/(double)nIntervals[group];
+	double arg=sum2s[group]/(double)nIntervals[group]-avg*avg;
+	if(arg > 0) return sqrt(arg);
+	else return 0.0;
+    } else {
+	return 0;
+    }
+}
+
+void CGroupStore::update(int group, const epicsTime &time)
+{
+    nIntervals[group]++;
+    double delTime=time-lastTimes[group];
+    lastTimes[group]=time;
+    sums[group]+=delTime;
+    sum2s[group]+=delTime*delTime;
+
+    if(delTime > lastIntervals[group]) increasings[group]++;
+    unsigned char type=intervalTypes[group];
+    if(type == NoIntervals) {
+	if(delTime > 0.0) type=MonotonicIncreasing;
+	else if(delTime < 0.0) type=MonotonicDecreasing;
+    } else if(type == MonotonicIncreasing) {
+	if(delTime < maxs[group]) type=IncreasingDecreasing;
+    } else if(type == MonotonicDecreasing) {
+	if(delTime > mins[group]) type=IncreasingDecreasing;
+    }
+    intervalTypes[group]=type;
+
+    if(delTime > maxs[group]) maxs[group]=delTime;
+    if(delTime < mins[group]) mins[group]=delTime;
+    if(delTime < 0) outOfOrders[group]++;
+    lastIntervals[group]=delTime;
+
+    if(!sketches[group]) {
+	sketches[group]=new(sketchPool.allocate()) CSketch;
+	nSketches++;
+    }
+    sketchBytes+=sketches[group]->add(delTime);
+}
+
+// Returns the sketch of a group, if it has one, to the sketch pool
+void CGroupStore::freeSketch(int group)
+{
+    CSketch *pSketch=sketches[group];
+
+    if(!pSketch) return;
+    sketchBytes-=pSketch->getExtraBytes();
+    pSketch->~CSketch();
+    sketchPool.release(pSketch);
+    sketches[group]=NULL;
+    nSketches--;
+}
+
+void CGroupStore::setFinished(int group)
+{
+    if(flags[group]&GROUP_FINISHED) return;
+    flags[group]|=GROUP_FINISHED;
+    if(deadlines) addFinished(group);
+}
+
+// Finishes the open groups whose last time is more than newGroupTime
+// before the given time and puts them on the finished list
+void CGroupStore::expire(const epicsTime &time, double newGroupTime)
+{
+    while(nHeap > 0 && time-heapTimes[0] > newGroupTime) {
+	int group=heapGroups[0];
+	epicsTime queuedTime=heapTimes[0];
+	pop();
+	flags[group]&=~GROUP_QUEUED;
+	if(!(flags[group]&GROUP_USED) || (flags[group]&GROUP_FINISHED)) {
+	    continue;
+	}
+	if(queuedTime < lastTimes[group]) {
+	  // It has had events since it was queued
+	    push(group);
+	    continue;
+	}
+	setFinished(group);
+    }
+}
+
+// Queues a group on the heap with its last time
+void CGroupStore::push(int group)
+{
+    if(nHeap >= heapSize) {
+	int newSize=heapSize?2*heapSize:GROUP_HEAP_SIZE;
+	growArray(heapGroups,nHeap,newSize);
+	growArray(heapTimes,nHeap,newSize);
+	heapSize=newSize;
+    }
+
+  // Sift up
+    const epicsTime &time=lastTimes[group];
+    int i=nHeap++;
+    while(i > 0) {
+	int parent=(i-1)/2;
+	if(!(time < heapTimes[parent])) break;
+	heapGroups[i]=heapGroups[parent];
+	heapTimes[i]=heapTimes[parent];
+	i=parent;
+    }
+    heapGroups[i]=group;
+    heapTimes[i]=time;
+    flags[group]|=GROUP_QUEUED;
+}
+
+// Removes the top of the heap
+void CGroupStore::pop(void)
+{
+    if(--nHeap <= 0) return;
+
+  // Sift the last entry down from the top
+    int group=heapGroups[nHeap];
+    epicsTime time=heapTimes[nHeap];
+    int i=0;
+    for(;;) {
+	int child=2*i+1;
+	if(child >= nHeap) break;
+	if(child+1 < nHeap && heapTimes[child+1] < heapTimes[child]) child++;
+	if(!(heapTimes[child] < time)) break;
+	heapGroups[i]=heapGroups[child];
+	heapTimes[i]=heapTimes[child];
+	i=child;
+    }
+    heapGroups[i]=group;
+    heapTimes[i]=time;
+}
+
+// Puts a group on the list of finished groups
+void CGroupStore::addFinished(int group)
+{
+    if(nFinished >= finishedSize) {
+	int newSize=finishedSize?2*finishedSize:GROUP_HEAP_SIZE;
+	growArray(finishedList,nFinished,newSize);
+	finishedSize=newSize;
+    }
+    finishedList[nFinished++]=group;
+}
+
+// Fills in the summary of a group.  It is not linked.
+void CGroupStore::summarize(int group, GroupSummary &summary) const
+{
+    const CSketch *pSketch=sketches[group];
+
+    summary.firstTime=firstTimes[group];
+    summary.lastTime=lastTimes[group];
+    summary.mean=getMean(group);
+    summary.sigma=getSigma(group);
+    summary.min=mins[group];
+    summary.max=maxs[group];
+    summary.p50=pSketch?pSketch->getQuantile(.50):0.0;
+    summary.p90=pSketch?pSketch->getQuantile(.90):0.0;
+    summary.p99=pSketch?pSketch->getQuantile(.99):0.0;
+    summary.iocId=iocIds[group];
+    summary.nIntervals=nIntervals[group];
+    summary.increasing=increasings[group];
+    summary.outOfOrder=outOfOrders[group];
+    summary.intervalType=intervalTypes[group];
+}
+
+// Returns the size of one group in the arrays
+size_t CGroupStore::getGroupBytes(void)
+{
+    return 2*sizeof(unsigned char)+6*sizeof(int)+
+      2*sizeof(epicsTime)+5*sizeof(double)+sizeof(CSketch *);
+}
+
+// Returns the size of the arrays, not counting the sketches, which are
+// in the sketch pool
+size_t CGroupStore::getBytes(void) const
+{
+    return (size_t)capacity*getGroupBytes();
+}
+
+// Returns the size of the groups in use and their sketches, including
+// the buckets of sketches that have outgrown their inline ones
+size_t CGroupStore::getUsedBytes(void) const
+{
+    return (size_t)nUsed*getGroupBytes()+
+      (size_t)nSketches*sizeof(CSketch)+sketchBytes;
+}
+
+// Formats the lines with the usage of the pools and the store into
+// buf, so they can be taken while the store is not changing and
+// printed later
+void CGroupStore::formatStats(char *buf, size_t bufSize) const
+{
+    size_t len;
+
+    iocPool.formatStats(buf,bufSize);
+    len=strlen(buf);
+    sketchPool.formatStats(buf+len,bufSize-len);
+    len=strlen(buf);
+    if(deadlines) {
+	epicsSnprintf(buf+len,bufSize-len,"Group store: %u in use, "
+	  "%u high water, %d allocated (%.1f KiB), %d queued\n",
+	  nUsed,highWater,capacity,getBytes()/1024.,nHeap);
+    } else {
+	epicsSnprintf(buf+len,bufSize-len,"Group store: %u in use, "
+	  "%u high water, %d allocated (%.1f KiB)\n",
+	  nUsed,highWater,capacity,getBytes()/1024.);
+    }
+}
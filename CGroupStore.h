@@ -0,0 +1,145 @@
+// Store of the groups of beacon anomalies for ParseCASW
+
+#ifndef _INC_CGROUPSTORE_H
+#define _INC_CGROUPSTORE_H
+
+#include <stdio.h>
+
+#include <epicsTime.h>
+
+#include "CPool.h"
+#include "CSketch.h"
+#include "CSummaryStore.h"
+
+typedef enum _IntervalType {
+    NoIntervals,
+    IncreasingDecreasing,
+    MonotonicIncreasing,
+    MonotonicDecreasing
+} IntervalType;
+
+// Flags for a group
+#define GROUP_USED 0x1
+#define GROUP_FINISHED 0x2
+#define GROUP_QUEUED 0x4
+
+// The groups are kept as a struct of arrays indexed by the group id,
+// so sorting, finding the finished groups, and reporting are linear
+// scans of dense arrays.  Iterate from 0 to getSize()-1 and skip the
+// ids that are not used.  The groups of a server are linked through
+// the next and prev arrays in time order, and the server is linked by
+// its id.  The ids of removed groups are reused.
+//
+// With trackDeadlines() the open groups are also kept in a min-heap on
+// the last time they had when they were queued, and the groups that
+// are finished are put on a list.  expire() then finishes the groups
+// with no events for newGroupTime by looking only at the top of the
+// heap.  The heap is not changed by update(), so an entry can be
+// older than its group, and it is queued again with the current last
+// time when it reaches the top.
+//
+// The store also has the pools for the CIocs that use it and for the
+// sketches of its groups, so each shard or chunk allocates from its
+// own pools without a lock.
+class CGroupStore
+{
+  public:
+    CGroupStore(void);
+    ~CGroupStore(void);
+    int add(int iocId, const epicsTime &time);
+    int copy(const CGroupStore &store, int group, int iocId);
+    void remove(int group);
+    void update(int group, const epicsTime &time);
+    void trackDeadlines(void) { deadlines=1; }
+    void expire(const epicsTime &time, double newGroupTime);
+    int getFinishedCount(void) const { return nFinished; }
+    int getFinished(int i) const { return finishedList[i]; }
+    void clearFinished(void) { nFinished=0; }
+    int getQueuedCount(void) const { return nHeap; }
+    int getSize(void) const { return size; }
+    unsigned count(void) const { return nUsed; }
+    unsigned getHighWater(void) const { return highWater; }
+    int getCapacity(void) const { return capacity; }
+    size_t getBytes(void) const;
+    size_t getUsedBytes(void) const;
+    CPool &getIocPool(void) { return iocPool; }
+    void formatStats(char *buf, size_t bufSize) const;
+
+    int isUsed(int group) const { return flags[group]&GROUP_USED; }
+    int isFinished(int group) const { return flags[group]&GROUP_FINISHED; }
+    void setFinished(int group);
+    int getIoc(int group) const { return iocIds[group]; }
+    int getNext(int group) const { return nexts[group]; }
+    int getPrev(int group) const { return prevs[group]; }
+    void setNext(int group, int next) { nexts[group]=next; }
+    void setPrev(int group, int prev) { prevs[group]=prev; }
+    const epicsTime &getFirstTime(int group) const {
+	return firstTimes[group];
+    }
+    const epicsTime &getLastTime(int group) const {
+	return lastTimes[group];
+    }
+    int getNPoints(int group) const { return nIntervals[group]+1; }
+    int getNIntervals(int group) const { return nIntervals[group]; }
+    double getMean(int group) const;
+    double getSigma(int group) const;
+    double getMin(int group) const { return mins[group]; }
+    double getMax(int group) const { return maxs[group]; }
+    IntervalType getIntervalType(int group) const {
+	return (IntervalType)intervalTypes[group];
+    }
+    int getOutOfOrder(int group) const { return outOfOrders[group]; }
+    int getIncreasing(int group) const { return increasings[group]; }
+    const CSketch *getSketch(int group) const { return sketches[group]; }
+    void summarize(int group, GroupSummary &summary) const;
+
+  private:
+    static size_t getGroupBytes(void);
+    int allocate(void);
+    void grow(void);
+    void push(int group);
+    void pop(void);
+    void addFinished(int group);
+    void freeSketch(int group);
+
+    CPool iocPool;
+    CPool sketchPool;
+    int size;
+    int capacity;
+    unsigned nUsed;
+    unsigned highWater;
+    unsigned nSketches;
+    size_t sketchBytes;
+    int freeList;
+    int deadlines;
+
+  // The heap of open groups and the list of finished groups
+    int *heapGroups;
+    epicsTime *heapTimes;
+    int nHeap;
+    int heapSize;
+    int *finishedList;
+    int nFinished;
+    int finishedSize;
+
+  // Indexed by group id
+    unsigned char *flags;
+    unsigned char *intervalTypes;
+    int *iocIds;
+    int *nexts;
+    int *prevs;
+    epicsTime *firstTimes;
+    epicsTime *lastTimes;
+    int *nIntervals;
+    double *sums;
+    double *sum2s;
+    double *maxs;
+    double *mins;
+    double *lastIntervals;
+    int *increasings;
+    int *outOfOrders;
+  // Made when the group has its first interval
+    CSketch **sketches;
+};
+
+#endif // _INC_CGROUPSTORE_H
@@ -2,152 +2,202 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <float.h>
 
 #include "CIoc.h"
 #include "utils.h"
 
 // Class CIoc implementations
 
-CIoc::CIoc(const char *name, epicsTime &time) :
-    stringId(name),
+CIoc::CIoc(const char *nameIn, int idIn, epicsTime &time,
+  CGroupStore &store) :
+    name(nameIn),
+    id(idIn),
+    pStore(&store),
+    firstGroup(-1),
+    lastGroup(-1),
+    nGroups(0),
+    summarySlot(-1),
+    nSummaries(0),
     firstTime(time),
     lastTime(firstTime),
-    curGroup(NULL)
+    curGroup(-1)
 {
-    curGroup=new CGroup(*this,time);
-    if(!curGroup) {
-	errMsg("Failed to create a group for %s\n",name);
-	exit(1);
-    }
-    groupList.add(*curGroup);
+    curGroup=pStore->add(id,time);
+    addGroup(curGroup);
 }
 
 CIoc::~CIoc(void)
 {
-    CGroup *pGroup;
+  // Remove all the groups from the store
+    while(nGroups) removeGroup(lastGroup);
+}
 
-  // Remove all the groups from the list and delete them
-    while(groupList.count()) {
-	pGroup=groupList.last();
-      // Deleting the group should remove it from the list
-	delete pGroup;
-    }
+// Deletes a CIoc made with new(store) and returns it to the pool of
+// its store
+void CIoc::destroy(CIoc *pIoc)
+{
+    if(!pIoc) return;
+    CPool &pool=pIoc->pStore->getIocPool();
+    pIoc->~CIoc();
+    pool.release(pIoc);
+}
+
+// Links a group from the store at the end of the list
+void CIoc::addGroup(int group)
+{
+    pStore->setPrev(group,lastGroup);
+    pStore->setNext(group,-1);
+    if(lastGroup >= 0) pStore->setNext(lastGroup,group);
+    else firstGroup=group;
+    lastGroup=group;
+    nGroups++;
+}
+
+// Unlinks a group and removes it from the store
+void CIoc::removeGroup(int group)
+{
+    int prev=pStore->getPrev(group);
+    int next=pStore->getNext(group);
+
+    if(prev >= 0) pStore->setNext(prev,next);
+    else firstGroup=next;
+    if(next >= 0) pStore->setPrev(next,prev);
+    else lastGroup=prev;
+    nGroups--;
+    if(curGroup == group) curGroup=-1;
+    pStore->remove(group);
 }
 
 void CIoc::update(epicsTime &time, double newGroupTime)
 {
-  // Update the last Time
+  // Update the intervals and the last Time
+    sketch.add(time-lastTime);
     lastTime=time;
 
   // If there is no current group make one
-    if(!curGroup) {
-	curGroup=new CGroup(*this,time);
-	if(!curGroup) {
-	    errMsg("Failed to create a group for %s\n",
-	      resourceName());
-	    exit(1);
-	}
+    if(curGroup < 0) {
+	curGroup=pStore->add(id,time);
+	addGroup(curGroup);
 	return;
     }
 
   // If there is a current group, check if it needs to be ended
   // because the time since the last time has exceeded newGroupTime
-    double delTime=time-curGroup->getLastTime();
+    double delTime=time-pStore->getLastTime(curGroup);
     if(delTime > newGroupTime) {
-	curGroup->setFinished(1);
-	curGroup=new CGroup(*this,time);
-	if(!curGroup) {
-	    errMsg("Failed to create a group for %s\n",
-	      resourceName());
-	    exit(1);
-	}
-	groupList.add(*curGroup);
+	pStore->setFinished(curGroup);
+	curGroup=pStore->add(id,time);
+	addGroup(curGroup);
 	return;
     }
 
   // Else update the current group
-    curGroup->update(time);
+    pStore->update(curGroup,time);
 }
 
-// Class CGroup implementations
+// Moves the groups of another CIoc for the same server to the end of
+// this one.  The other groups are for times after the last time of
+// this one and start with a new group, as when the groups were split
+// by a time greater than newGroupTime.  The other CIoc is left empty.
+void CIoc::append(CIoc &ioc)
+{
+    int group,newCurGroup=-1;
+
+    if(curGroup >= 0) pStore->setFinished(curGroup);
+    for(group=ioc.firstGroup; group >= 0;
+	group=ioc.pStore->getNext(group)) {
+	int newGroup=pStore->copy(*ioc.pStore,group,id);
+	addGroup(newGroup);
+	if(group == ioc.curGroup) newCurGroup=newGroup;
+    }
+    while(ioc.nGroups) ioc.removeGroup(ioc.lastGroup);
+    curGroup=newCurGroup;
+
+  // Add the interval to the first event of the other one and then its
+  // intervals
+    sketch.add(ioc.firstTime-lastTime);
+    sketch.merge(ioc.sketch);
+    lastTime=ioc.lastTime;
+}
 
-CGroup::CGroup(CIoc &iocIn,epicsTime &time) :
-    ioc(iocIn),
-    firstTime(time),
-    lastTime(firstTime),
-    nIntervals(0),
-    sum(0.0),
-    sum2(0.0),
-    max(DBL_MIN),
-    min(DBL_MAX),
-    lastInterval(0.0),
-    increasing(0),
-    intervalType(NoIntervals),
-    finished(0),
-    outOfOrder(0)
+// Replaces the finished groups with summaries at the end of the
+// summaries of this server.  Only the current group is not finished in file mode, and
+// it is the last one, so the summaries stay before the groups.
+void CIoc::compact(CSummaryStore &summaries)
 {
+    GroupSummary summary;
+    int group,next;
+
+    for(group=firstGroup; group >= 0; group=next) {
+	next=pStore->getNext(group);
+	if(!pStore->isFinished(group)) continue;
+	pStore->summarize(group,summary);
+	if(summarySlot < 0) summarySlot=summaries.addServer(id,firstTime);
+	summaries.add(summarySlot,summary);
+	nSummaries++;
+	removeGroup(group);
+    }
 }
 
-CGroup::~CGroup(void)
+// Fills in the summary of the server
+void CIoc::summarize(IocSummary &summary) const
 {
-  // Remove it from the list
-    tsDLList<CGroup> *pGroupList=ioc.getGroupList();
-    pGroupList->remove(*this);
+    unsigned nIntervals=sketch.getCount();
+
+    summary.firstTime=firstTime;
+    summary.lastTime=lastTime;
+    summary.p50=nIntervals?sketch.getQuantile(.50):0.0;
+    summary.p90=nIntervals?sketch.getQuantile(.90):0.0;
+    summary.p99=nIntervals?sketch.getQuantile(.99):0.0;
+    summary.nIntervals=nIntervals;
+    summary.nGroups=nSummaries+nGroups;
 }
 
-double CGroup::getMean(void) const
+// Class CIocTable implementations
+
+// Initial size of the table, which doubles as needed
+#define IOC_TABLE_SIZE 64
+
+CIocTable::CIocTable(void) :
+    iocs(NULL),
+    size(0),
+    nIocs(0)
 {
-    if(nIntervals > 0) {
-	double avg=sum/(double)nIntervals;
-	return avg;
-    } else {
-	return 0;
-    }
 }
 
-double CGroup::getSigma(void) const
+CIocTable::~CIocTable(void)
 {
-  // Use sigma=sqrt(sum(x-xbar)^2/n), not n-1 version
-    if(nIntervals > 1) {
-	double avg=sum/(double)nIntervals;
-	double arg=sum2/(double)nIntervals-avg*avg;
-	if(arg > 0) return sqrt(arg);
-	else return 0.0;
-    } else {
-	return 0;
-    }
+    if(iocs) delete [] iocs;
 }
 
-void CGroup::update(epicsTime &time)
+void CIocTable::add(CIoc &ioc)
 {
-    nIntervals++;
-    double delTime=time-lastTime;
-    lastTime=time;
-    sum+=delTime;
-    sum2+=delTime*delTime;
-
-    if(delTime > lastInterval) increasing++;
-    if(intervalType == NoIntervals) {
-	if(delTime > 0.0) intervalType=MonotonicIncreasing;
-	else if(delTime < 0.0) intervalType=MonotonicDecreasing;
-    } else if(intervalType == MonotonicIncreasing) {
-	if(delTime < max) intervalType=IncreasingDecreasing;
-    } else if(intervalType == MonotonicDecreasing) {
-	if(delTime > min) intervalType=IncreasingDecreasing;
+    int id=ioc.getId();
+
+    if(id >= size) {
+	int newSize=size?size:IOC_TABLE_SIZE;
+	while(newSize <= id) newSize*=2;
+	CIoc **newIocs=new CIoc *[newSize];
+	if(!newIocs) {
+	    errMsg("Cannot allocate space for IOC table");
+	    exit(1);
+	}
+	for(int i=0; i < size; i++) newIocs[i]=iocs[i];
+	for(int i=size; i < newSize; i++) newIocs[i]=NULL;
+	if(iocs) delete [] iocs;
+	iocs=newIocs;
+	size=newSize;
     }
-
-    if(delTime > max) max=delTime;
-    if(delTime < min) min=delTime;
-    if(delTime < 0) outOfOrder++;
-    lastInterval=delTime;
+    if(!iocs[id]) nIocs++;
+    iocs[id]=&ioc;
 }
 
-void CGroup::checkFinished(epicsTime &time, double newGroupTime)
+void CIocTable::remove(CIoc &ioc)
 {
-    double delTime=time-getLastTime();
-    if(delTime > newGroupTime) {
-	setFinished(1);
-	getIoc().setCurGroup(NULL);
+    int id=ioc.getId();
+
+    if(id < size && iocs[id] == &ioc) {
+	iocs[id]=NULL;
+	nIocs--;
     }
 }
@@ -4,78 +4,98 @@
 #define _INC_CIOC_H
 
 #include <epicsTime.h>
-#include <resourceLib.h>
-#include "tsDLList.h"
 
-#endif // _INC_CIOC_H
-
-typedef enum _IntervalType {
-    NoIntervals,
-    IncreasingDecreasing,
-    MonotonicIncreasing,
-    MonotonicDecreasing
-} IntervalType;
+#include "CGroupStore.h"
+#include "CSketch.h"
+#include "CSummaryStore.h"
 
-class CIoc;
-class CGroup;
+// What the reports need of a server besides its groups.  The
+// percentiles are of all its intervals, and are 0 if there are none.
+struct IocSummary
+{
+    epicsTimeStamp firstTime;
+    epicsTimeStamp lastTime;
+    double p50;
+    double p90;
+    double p99;
+    unsigned nIntervals;
+    unsigned nGroups;
+};
 
-class CIoc : public tsSLNode <CIoc>, public stringId
+// The name is interned in a CNameTable, which owns it, and id is its
+// id there.  Its groups are in a CGroupStore, linked in time order from
+// getFirstGroup() through CGroupStore::getNext().  The group ids are
+// -1 for none.  The sketch has the intervals between all its events.
+// Finished groups that have been compacted are in a CSummaryStore,
+// in time order in the slot from getSummarySlot(), or -1 if none have
+// been.  They are all before the groups.  It is made with new(store) from the server pool of its
+// store and deleted with destroy().
+class CIoc
 {
   public:
-    CIoc(const char *name, epicsTime &time);
+    CIoc(const char *name, int id, epicsTime &time, CGroupStore &store);
     ~CIoc(void);
-    tsDLList<CGroup> *getGroupList(void) { return &groupList; }
+    static void *operator new(size_t size, CGroupStore &store) {
+	return store.getIocPool().allocate();
+    }
+    static void operator delete(void *p, CGroupStore &store) {
+	store.getIocPool().release(p);
+    }
+    static void destroy(CIoc *pIoc);
+    const char *getName(void) const { return name; }
+    int getId(void) const { return id; }
     epicsTime getFirstTime(void) const { return firstTime; }
     epicsTime getLastTime(void) const { return lastTime; }
     
-    unsigned getGroupCount(void) const { return groupList.count(); }
+    unsigned getGroupCount(void) const { return nGroups; }
+    int getFirstGroup(void) const { return firstGroup; }
+    unsigned getSummaryCount(void) const { return nSummaries; }
+    int getSummarySlot(void) const { return summarySlot; }
+    const CSketch &getSketch(void) const { return sketch; }
     void update(epicsTime &time, double newGroupTime);
-    CGroup *getCurGroup(void) const { return curGroup; }
-    void setCurGroup(CGroup *curGroupIn) { curGroup=curGroupIn; }
+    int getCurGroup(void) const { return curGroup; }
+    void setCurGroup(int curGroupIn) { curGroup=curGroupIn; }
+    void removeGroup(int group);
+    void append(CIoc &ioc);
+    void compact(CSummaryStore &summaries);
+    void summarize(IocSummary &summary) const;
 
   private:
-    tsDLList<CGroup> groupList;
+    void addGroup(int group);
+
+    const char *name;
+    int id;
+    CGroupStore *pStore;
+    int firstGroup;
+    int lastGroup;
+    unsigned nGroups;
+    int summarySlot;
+    unsigned nSummaries;
     epicsTime firstTime;
     epicsTime lastTime;
-    CGroup *curGroup;
+    int curGroup;
+    CSketch sketch;
 };
 
-class CGroup : public tsDLNode<CGroup>
+// The CIocs indexed by the ids of their names.  Iterate from 0 to
+// getSize()-1 and skip the NULL entries.  It does not own the CIocs.
+class CIocTable
 {
   public:
-    CGroup(CIoc &ioc, epicsTime &time);
-    ~CGroup(void);
-
-    epicsTime getFirstTime(void) const { return firstTime; }
-    epicsTime getLastTime(void) const { return lastTime; }
-    
-    void update(epicsTime &time);
-    void checkFinished(epicsTime &time, double newGroupTime);
-    int getNPoints(void) const { return nIntervals+1; }
-    int getNIntervals(void) const { return nIntervals; }
-    double getMean(void) const;
-    double getSigma(void) const;
-    double getMin(void) const { return min; }
-    double getMax(void) const { return max; }
-    int isFinished(void) const { return finished; }
-    void setFinished(int val) { finished=val; }
-    IntervalType getIntervalType(void) const { return intervalType; }
-    int getOutOfOrder(void) const { return outOfOrder; }
-    int getIncreasing(void) const { return increasing; }
-    CIoc &getIoc(void) const { return ioc; }
+    CIocTable(void);
+    ~CIocTable(void);
+    CIoc *lookup(int id) const {
+	return (id >= 0 && id < size)?iocs[id]:NULL;
+    }
+    void add(CIoc &ioc);
+    void remove(CIoc &ioc);
+    int getSize(void) const { return size; }
+    unsigned count(void) const { return nIocs; }
 
   private:
-    CIoc &ioc;
-    epicsTime firstTime;
-    epicsTime lastTime;
-    int nIntervals;
-    double sum;
-    double sum2;
-    double max;
-    double min;
-    double lastInterval;
-    int increasing;
-    IntervalType intervalType;
-    int finished;
-    int outOfOrder;
+    CIoc **iocs;
+    int size;
+    unsigned nIocs;
 };
+
+#endif // _INC_CIOC_H
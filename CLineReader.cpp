@@ -0,0 +1,179 @@
+// Implementation of the buffered line reader for ParseCASW
+
+// The input is read LINE_READ_SIZE bytes at a time and the lines are
+// found with memchr, so there is one read per block rather than per
+// line.  A line that is not complete at the end of the buffer is moved
+// to the start before the next read, and the buffer grows if a line is
+// too long to leave room for a full read.  There is no limit on the
+// length of a line.  A read from stdin returns what is available, so
+// lines from a pipe are processed as they arrive.
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#ifdef WIN32
+# include <io.h>
+#endif
+
+#include "utils.h"
+#include "CLineReader.h"
+
+// Size of each read
+#define LINE_READ_SIZE 1048576
+
+CLineReader::CLineReader(void) :
+    fd(-1),
+    ownFd(0),
+    status(P_OK),
+    errorString(NULL),
+    buf(NULL),
+    bufSize(0),
+    cur(NULL),
+    scan(NULL),
+    end(NULL),
+    eof(0)
+{
+}
+
+CLineReader::~CLineReader(void)
+{
+    close();
+    if(buf) delete [] buf;
+}
+
+// Opens a file, which is decompressed if it is compressed.  Returns
+// P_OK or P_ERROR, in which case getErrorString() tells why.
+int CLineReader::open(const char *fileName)
+{
+    close();
+
+    CompressionType type=CCompressedFile::detect(fileName);
+    if(type != CT_NONE) {
+	if(compressedFile.open(fileName,type) != P_OK) {
+	    status=P_ERROR;
+	    errorString=compressedFile.getErrorString();
+	    return P_ERROR;
+	}
+	return P_OK;
+    }
+
+#ifdef WIN32
+    fd=_open(fileName,_O_RDONLY|_O_BINARY);
+#else
+    fd=::open(fileName,O_RDONLY);
+#endif
+    if(fd < 0) {
+	status=P_ERROR;
+	errorString="Cannot open file";
+	return P_ERROR;
+    }
+    ownFd=1;
+    return P_OK;
+}
+
+int CLineReader::openStdin(void)
+{
+    close();
+    fd=0;
+    ownFd=0;
+    return P_OK;
+}
+
+void CLineReader::close(void)
+{
+    if(ownFd && fd >= 0) {
+#ifdef WIN32
+	_close(fd);
+#else
+	::close(fd);
+#endif
+    }
+    fd=-1;
+    ownFd=0;
+    compressedFile.close();
+    cur=scan=end=buf;
+    eof=0;
+}
+
+// Sets the next line, including its newline if any, and returns 1, or
+// returns 0 at the end of the input or on an error
+int CLineReader::getLine(const char **pStart, const char **pEnd)
+{
+    while(1) {
+	char *nl=NULL;
+	if(scan < end) nl=(char *)memchr(scan,'\n',(size_t)(end-scan));
+	if(nl) {
+	    *pStart=cur;
+	    *pEnd=nl+1;
+	    cur=scan=nl+1;
+	    return 1;
+	}
+	scan=end;
+	if(eof) {
+	  // The last line has no newline
+	    if(cur >= end) return 0;
+	    *pStart=cur;
+	    *pEnd=end;
+	    cur=scan=end;
+	    return 1;
+	}
+	fill();
+    }
+}
+
+// Reads more input after the incomplete line.  Returns the number of
+// bytes read, which is 0 at the end or on an error.
+int CLineReader::fill(void)
+{
+    size_t partial=(size_t)(end-cur);
+    size_t scanned=(size_t)(scan-cur);
+
+  // Move the incomplete line to the start, growing the buffer if there
+  // is not room for a full read after it
+    if(partial+LINE_READ_SIZE > bufSize) {
+	size_t newSize=bufSize?bufSize:2*LINE_READ_SIZE;
+	while(partial+LINE_READ_SIZE > newSize) newSize*=2;
+	char *newBuf=new char[newSize];
+	if(!newBuf) {
+	    errMsg("Cannot allocate space for input buffer");
+	    exit(1);
+	}
+	if(partial) memcpy(newBuf,cur,partial);
+	if(buf) delete [] buf;
+	buf=newBuf;
+	bufSize=newSize;
+    } else if(partial && cur != buf) {
+	memmove(buf,cur,partial);
+    }
+    cur=buf;
+    scan=buf+scanned;
+    end=buf+partial;
+
+    long n;
+    if(compressedFile.isOpen()) {
+	n=(long)compressedFile.read(end,LINE_READ_SIZE);
+	if(!n && compressedFile.getStatus() != P_OK) {
+	    status=P_ERROR;
+	    errorString=compressedFile.getErrorString();
+	}
+    } else {
+	do {
+#ifdef WIN32
+	    n=_read(fd,end,LINE_READ_SIZE);
+#else
+	    n=::read(fd,end,LINE_READ_SIZE);
+#endif
+	} while(n < 0 && errno == EINTR);
+	if(n < 0) {
+	    status=P_ERROR;
+	    errorString="Error reading file";
+	    n=0;
+	}
+    }
+    if(!n) eof=1;
+    end+=n;
+
+    return (int)n;
+}
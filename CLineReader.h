@@ -0,0 +1,41 @@
+// Buffered line reader for ParseCASW
+
+#ifndef _INC_CLINEREADER_H
+#define _INC_CLINEREADER_H
+
+#include <stddef.h>
+
+#include "parsecasw.h"
+#include "CCompressedFile.h"
+
+// Reads lines of any length from stdin, a file, or a compressed file
+// in large blocks.  The lines are framed in place in the buffer.
+class CLineReader
+{
+  public:
+    CLineReader(void);
+    ~CLineReader(void);
+    int open(const char *fileName);
+    int openStdin(void);
+    void close(void);
+    int isOpen(void) const { return fd >= 0 || compressedFile.isOpen(); }
+    int getLine(const char **pStart, const char **pEnd);
+    int getStatus(void) const { return status; }
+    const char *getErrorString(void) const { return errorString; }
+
+  private:
+    int fill(void);
+    int fd;
+    int ownFd;
+    CCompressedFile compressedFile;
+    int status;
+    const char *errorString;
+    char *buf;
+    size_t bufSize;
+    char *cur;
+    char *scan;
+    char *end;
+    int eof;
+};
+
+#endif // _INC_CLINEREADER_H
@@ -0,0 +1,76 @@
+// Implementation of the memory-mapped input file for ParseCASW
+
+// The file is mapped read only and the lines are framed in place, so
+// there is no copy and no system call per line.  Where mapping is not
+// available open() fails and the caller reads the file with a
+// CLineReader instead.
+
+#include "parsecasw.h"
+#include "CMappedFile.h"
+
+#ifndef WIN32
+# include <fcntl.h>
+# include <sys/mman.h>
+#endif
+
+CMappedFile::CMappedFile(void) :
+    begin(NULL),
+    end(NULL),
+    open_(0)
+#ifndef WIN32
+    ,fd(-1)
+#endif
+{
+}
+
+CMappedFile::~CMappedFile(void)
+{
+    close();
+}
+
+int CMappedFile::open(const char *fileName)
+{
+#ifdef WIN32
+    return P_ERROR;
+#else
+    struct stat statBuf;
+
+    close();
+    fd=::open(fileName,O_RDONLY);
+    if(fd < 0) return P_ERROR;
+  // Only map regular files
+    if(fstat(fd,&statBuf) || !S_ISREG(statBuf.st_mode)) {
+	::close(fd);
+	fd=-1;
+	return P_ERROR;
+    }
+    size_t size=(size_t)statBuf.st_size;
+    if(size > 0) {
+	void *addr=mmap(NULL,size,PROT_READ,MAP_PRIVATE,fd,0);
+	if(addr == MAP_FAILED) {
+	    ::close(fd);
+	    fd=-1;
+	    return P_ERROR;
+	}
+      // The file is read once from start to end
+	madvise(addr,size,MADV_SEQUENTIAL);
+	begin=(const char *)addr;
+    } else {
+	begin=NULL;
+    }
+    end=begin+size;
+    open_=1;
+    return P_OK;
+#endif
+}
+
+void CMappedFile::close(void)
+{
+#ifndef WIN32
+    if(begin) munmap((void *)begin,(size_t)(end-begin));
+    if(fd >= 0) ::close(fd);
+    fd=-1;
+#endif
+    begin=end=NULL;
+    open_=0;
+}
@@ -0,0 +1,44 @@
+// Memory-mapped input file for ParseCASW
+
+#ifndef _INC_CMAPPEDFILE_H
+#define _INC_CMAPPEDFILE_H
+
+#include <stddef.h>
+#include <string.h>
+
+#include "parsecasw.h"
+
+// A file mapped into memory so that it can be split into chunks that
+// are analyzed in parallel
+class CMappedFile
+{
+  public:
+    CMappedFile(void);
+    ~CMappedFile(void);
+    int open(const char *fileName);
+    void close(void);
+    int isOpen(void) const { return open_; }
+    const char *getBegin(void) const { return begin; }
+    const char *getEnd(void) const { return end; }
+    size_t getSize(void) const { return (size_t)(end-begin); }
+    static const char *frameLine(const char *cur, const char *end);
+
+  private:
+    const char *begin;
+    const char *end;
+    int open_;
+#ifndef WIN32
+    int fd;
+#endif
+};
+
+// Returns the end of the line that starts at cur, including its
+// newline if any
+inline const char *CMappedFile::frameLine(const char *cur,
+  const char *end)
+{
+    const char *nl=(const char *)memchr(cur,'\n',(size_t)(end-cur));
+    return nl?nl+1:end;
+}
+
+#endif // _INC_CMAPPEDFILE_H
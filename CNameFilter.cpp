@@ -0,0 +1,203 @@
+// Implementation of the server name filters for ParseCASW
+
+// Node 0 is the root of the trie of names and prefixes and node 1 the
+// root of the trie of reversed suffixes.  The patterns are only added
+// while the command line is parsed, so the tries are not made compact.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parsecasw.h"
+#include "utils.h"
+#include "CNameFilter.h"
+
+// Flags of a node
+// A name ends here
+#define NODE_EXACT 0x1
+// A prefix that is followed by * ends here
+#define NODE_PREFIX 0x2
+// A suffix that is preceded by * ends here, in the reversed trie
+#define NODE_SUFFIX 0x4
+
+#define FORWARD_ROOT 0
+#define REVERSE_ROOT 1
+
+// Initial number of nodes
+#define TRIE_SIZE 256
+
+// Class CPatternSet implementations
+
+CPatternSet::CPatternSet(void) :
+    nodes(NULL),
+    nNodes(0),
+    nodesSize(0),
+    patterns(NULL),
+    nPatterns(0),
+    patternsSize(0),
+    matchAll(0),
+    nAdded(0)
+{
+}
+
+CPatternSet::~CPatternSet(void)
+{
+    for(int i=0; i < nPatterns; i++) delete [] patterns[i].suffix;
+    if(patterns) delete [] patterns;
+    if(nodes) delete [] nodes;
+}
+
+// Returns the child of the node with the label, or -1
+int CPatternSet::findChild(int node, unsigned char label) const
+{
+    for(int child=nodes[node].firstChild; child >= 0;
+	child=nodes[child].nextSibling) {
+	if(nodes[child].label == label) return child;
+    }
+    return -1;
+}
+
+// Returns the child of the node with the label, adding it if needed
+int CPatternSet::addChild(int node, unsigned char label)
+{
+    int child=(node >= 0)?findChild(node,label):-1;
+    if(child >= 0) return child;
+
+    if(nNodes >= nodesSize) {
+	int newSize=nodesSize?2*nodesSize:TRIE_SIZE;
+	TrieNode *newNodes=new TrieNode[newSize];
+	if(!newNodes) {
+	    errMsg("Cannot allocate space for filter nodes");
+	    exit(1);
+	}
+	for(int i=0; i < nNodes; i++) newNodes[i]=nodes[i];
+	if(nodes) delete [] nodes;
+	nodes=newNodes;
+	nodesSize=newSize;
+    }
+    child=nNodes++;
+    nodes[child].firstChild=-1;
+    nodes[child].nextSibling=-1;
+    nodes[child].firstPattern=-1;
+    nodes[child].label=label;
+    nodes[child].flags=0;
+    if(node >= 0) {
+	nodes[child].nextSibling=nodes[node].firstChild;
+	nodes[node].firstChild=child;
+    }
+    return child;
+}
+
+// Adds a pattern.  Returns P_OK, or P_ERROR if it has more than one *
+// or other wildcard characters.
+int CPatternSet::add(const char *pattern)
+{
+    size_t len=strlen(pattern);
+    const char *star=strchr(pattern,'*');
+    int node;
+    size_t i;
+
+    if(strpbrk(pattern,"?[") || (star && strchr(star+1,'*'))) {
+	return P_ERROR;
+    }
+    if(!nNodes) {
+	addChild(-1,0);
+	addChild(-1,0);
+    }
+    nAdded++;
+
+    if(!star) {
+	node=FORWARD_ROOT;
+	for(i=0; i < len; i++) node=addChild(node,(unsigned char)pattern[i]);
+	nodes[node].flags|=NODE_EXACT;
+	return P_OK;
+    }
+
+    size_t prefixLen=(size_t)(star-pattern);
+    size_t suffixLen=len-prefixLen-1;
+    if(!prefixLen && !suffixLen) {
+	matchAll=1;
+    } else if(!suffixLen) {
+	node=FORWARD_ROOT;
+	for(i=0; i < prefixLen; i++) {
+	    node=addChild(node,(unsigned char)pattern[i]);
+	}
+	nodes[node].flags|=NODE_PREFIX;
+    } else if(!prefixLen) {
+	node=REVERSE_ROOT;
+	for(i=len; i > 1; i--) {
+	    node=addChild(node,(unsigned char)pattern[i-1]);
+	}
+	nodes[node].flags|=NODE_SUFFIX;
+    } else {
+	node=FORWARD_ROOT;
+	for(i=0; i < prefixLen; i++) {
+	    node=addChild(node,(unsigned char)pattern[i]);
+	}
+	if(nPatterns >= patternsSize) {
+	    int newSize=patternsSize?2*patternsSize:16;
+	    FilterPattern *newPatterns=new FilterPattern[newSize];
+	    if(!newPatterns) {
+		errMsg("Cannot allocate space for filter patterns");
+		exit(1);
+	    }
+	    for(int j=0; j < nPatterns; j++) newPatterns[j]=patterns[j];
+	    if(patterns) delete [] patterns;
+	    patterns=newPatterns;
+	    patternsSize=newSize;
+	}
+	FilterPattern &filterPattern=patterns[nPatterns];
+	filterPattern.suffix=new char[suffixLen+1];
+	if(!filterPattern.suffix) {
+	    errMsg("Cannot allocate space for filter pattern");
+	    exit(1);
+	}
+	strcpy(filterPattern.suffix,star+1);
+	filterPattern.suffixLen=suffixLen;
+	filterPattern.next=nodes[node].firstPattern;
+	nodes[node].firstPattern=nPatterns++;
+    }
+
+    return P_OK;
+}
+
+// Returns 1 if the name, which is not necessarily NUL terminated,
+// matches one of the patterns, else 0
+int CPatternSet::matches(const char *name, size_t len) const
+{
+    int node;
+    size_t i;
+
+    if(matchAll) return 1;
+    if(!nNodes) return 0;
+
+  // Follow the name down the trie of names and prefixes
+    node=FORWARD_ROOT;
+    for(i=0; ; i++) {
+	if(nodes[node].flags & NODE_PREFIX) return 1;
+	for(int p=nodes[node].firstPattern; p >= 0; p=patterns[p].next) {
+	    const FilterPattern &filterPattern=patterns[p];
+	    if(i+filterPattern.suffixLen <= len &&
+	      !memcmp(name+len-filterPattern.suffixLen,filterPattern.suffix,
+		filterPattern.suffixLen)) {
+		return 1;
+	    }
+	}
+	if(i == len) {
+	    if(nodes[node].flags & NODE_EXACT) return 1;
+	    break;
+	}
+	node=findChild(node,(unsigned char)name[i]);
+	if(node < 0) break;
+    }
+
+  // Follow it from the end down the trie of suffixes
+    node=REVERSE_ROOT;
+    for(i=len; i > 0; i--) {
+	node=findChild(node,(unsigned char)name[i-1]);
+	if(node < 0) break;
+	if(nodes[node].flags & NODE_SUFFIX) return 1;
+    }
+
+    return 0;
+}
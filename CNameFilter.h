@@ -0,0 +1,81 @@
+// Server name filters for ParseCASW
+
+#ifndef _INC_CNAMEFILTER_H
+#define _INC_CNAMEFILTER_H
+
+#include <stddef.h>
+
+// A node of a trie.  The children of a node are a list linked through
+// nextSibling.
+struct TrieNode
+{
+    int firstChild;
+    int nextSibling;
+  // Patterns with a prefix and a suffix that end here, linked through
+  // FilterPattern::next
+    int firstPattern;
+    unsigned char label;
+    unsigned char flags;
+};
+
+// A pattern with both a prefix and a suffix.  The suffix is checked
+// when the prefix is matched.
+struct FilterPattern
+{
+    char *suffix;
+    size_t suffixLen;
+    int next;
+};
+
+// A set of patterns, which are a name, a prefix followed by *, a *
+// followed by a suffix, a prefix and a suffix with * between, or * by
+// itself.  The names and prefixes are in a trie of the bytes from the
+// start of the name, and the suffixes by themselves are in a trie of
+// the bytes from the end, so a match looks at each byte of the name at
+// most twice however many patterns there are.
+class CPatternSet
+{
+  public:
+    CPatternSet(void);
+    ~CPatternSet(void);
+    int add(const char *pattern);
+    int count(void) const { return nAdded; }
+    int matches(const char *name, size_t len) const;
+
+  private:
+    int findChild(int node, unsigned char label) const;
+    int addChild(int node, unsigned char label);
+
+    TrieNode *nodes;
+    int nNodes;
+    int nodesSize;
+    FilterPattern *patterns;
+    int nPatterns;
+    int patternsSize;
+    int matchAll;
+    int nAdded;
+};
+
+// The -include and -exclude patterns.  A name is accepted if it
+// matches an include pattern, or if there are none, and does not match
+// an exclude pattern.  It is used on the name bytes as they are in the
+// line, before the name is hashed or interned.
+class CNameFilter
+{
+  public:
+    int addInclude(const char *pattern) { return includes.add(pattern); }
+    int addExclude(const char *pattern) { return excludes.add(pattern); }
+    int isActive(void) const {
+	return includes.count() > 0 || excludes.count() > 0;
+    }
+    int accepts(const char *name, size_t len) const {
+	if(includes.count() > 0 && !includes.matches(name,len)) return 0;
+	return excludes.count() == 0 || !excludes.matches(name,len);
+    }
+
+  private:
+    CPatternSet includes;
+    CPatternSet excludes;
+};
+
+#endif // _INC_CNAMEFILTER_H
@@ -0,0 +1,187 @@
+// Implementation of the interned server name table for ParseCASW
+
+// The hash table is open addressing with linear probing and holds
+// ids.  It is kept at most half full.  The hash and length of each
+// name are kept so that probing only compares the bytes of likely
+// matches and growing does not hash the names again.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "CNameTable.h"
+
+// Initial number of names
+#define NAME_TABLE_SIZE 64
+// Size of the blocks in the string pool.  Longer names get their own
+// block.
+#define NAME_POOL_BLOCK_SIZE 65536
+
+CNameTable::CNameTable(int expected) :
+    slots(NULL),
+    slotMask(0),
+    names(NULL),
+    hashes(NULL),
+    lengths(NULL),
+    nNames(0),
+    namesSize(0),
+    blocks(NULL),
+    nBlocks(0),
+    blocksSize(0),
+    poolCur(NULL),
+    poolLeft(0)
+{
+    reserve(expected > NAME_TABLE_SIZE?expected:NAME_TABLE_SIZE);
+}
+
+CNameTable::~CNameTable(void)
+{
+    for(int i=0; i < nBlocks; i++) delete [] blocks[i];
+    if(blocks) delete [] blocks;
+    if(slots) delete [] slots;
+    if(names) delete [] names;
+    if(hashes) delete [] hashes;
+    if(lengths) delete [] lengths;
+}
+
+// Makes room for the expected number of names without growing
+void CNameTable::reserve(int expected)
+{
+    if(expected > namesSize) {
+	const char **newNames=new const char *[expected];
+	unsigned *newHashes=new unsigned[expected];
+	size_t *newLengths=new size_t[expected];
+	if(!newNames || !newHashes || !newLengths) {
+	    errMsg("Cannot allocate space for name table");
+	    exit(1);
+	}
+	for(int i=0; i < nNames; i++) {
+	    newNames[i]=names[i];
+	    newHashes[i]=hashes[i];
+	    newLengths[i]=lengths[i];
+	}
+	if(names) delete [] names;
+	if(hashes) delete [] hashes;
+	if(lengths) delete [] lengths;
+	names=newNames;
+	hashes=newHashes;
+	lengths=newLengths;
+	namesSize=expected;
+    }
+
+  // Keep the slots at most half full
+    unsigned nSlots=slotMask+1;
+    if(!slots) nSlots=0;
+    unsigned needed=1;
+    while(needed < 2*(unsigned)namesSize) needed<<=1;
+    if(needed > nSlots) rehash(needed);
+}
+
+void CNameTable::rehash(unsigned newSlots)
+{
+    int *newTable=new int[newSlots];
+    if(!newTable) {
+	errMsg("Cannot allocate space for name table slots");
+	exit(1);
+    }
+    for(unsigned i=0; i < newSlots; i++) newTable[i]=-1;
+    unsigned mask=newSlots-1;
+    for(int id=0; id < nNames; id++) {
+	unsigned slot=hashes[id]&mask;
+	while(newTable[slot] >= 0) slot=(slot+1)&mask;
+	newTable[slot]=id;
+    }
+    if(slots) delete [] slots;
+    slots=newTable;
+    slotMask=mask;
+}
+
+// Returns the id of the name, or -1 if it is not in the table
+int CNameTable::lookup(const char *name, size_t len, unsigned hashVal) const
+{
+    unsigned slot=hashVal&slotMask;
+    int id;
+
+    while((id=slots[slot]) >= 0) {
+	if(hashes[id] == hashVal && lengths[id] == len &&
+	  !memcmp(names[id],name,len)) {
+	    return id;
+	}
+	slot=(slot+1)&slotMask;
+    }
+    return -1;
+}
+
+// Returns the id of the name, adding it if it is not in the table
+int CNameTable::intern(const char *name, size_t len, unsigned hashVal)
+{
+    unsigned slot=hashVal&slotMask;
+    int id;
+
+    while((id=slots[slot]) >= 0) {
+	if(hashes[id] == hashVal && lengths[id] == len &&
+	  !memcmp(names[id],name,len)) {
+	    return id;
+	}
+	slot=(slot+1)&slotMask;
+    }
+
+  // Add it
+    if(nNames >= namesSize) {
+	reserve(2*namesSize);
+      // The slots have changed
+	slot=hashVal&slotMask;
+	while(slots[slot] >= 0) slot=(slot+1)&slotMask;
+    }
+    char *str=poolAlloc(len+1);
+    memcpy(str,name,len);
+    str[len]='\0';
+    id=nNames++;
+    names[id]=str;
+    hashes[id]=hashVal;
+    lengths[id]=len;
+    slots[slot]=id;
+    return id;
+}
+
+// Returns space for a name from the pool
+char *CNameTable::poolAlloc(size_t size)
+{
+    char *block;
+
+    if(size <= poolLeft) {
+	char *str=poolCur;
+	poolCur+=size;
+	poolLeft-=size;
+	return str;
+    }
+
+  // Get a new block
+    size_t blockSize=(size > NAME_POOL_BLOCK_SIZE/4)?size:NAME_POOL_BLOCK_SIZE;
+    block=new char[blockSize];
+    if(!block) {
+	errMsg("Cannot allocate space for name pool");
+	exit(1);
+    }
+    if(nBlocks >= blocksSize) {
+	int newSize=blocksSize?2*blocksSize:16;
+	char **newBlocks=new char *[newSize];
+	if(!newBlocks) {
+	    errMsg("Cannot allocate space for name pool blocks");
+	    exit(1);
+	}
+	for(int i=0; i < nBlocks; i++) newBlocks[i]=blocks[i];
+	if(blocks) delete [] blocks;
+	blocks=newBlocks;
+	blocksSize=newSize;
+    }
+    blocks[nBlocks++]=block;
+
+  // Keep using the current block for small names if the name got its
+  // own block
+    if(blockSize == size) return block;
+    poolCur=block+size;
+    poolLeft=blockSize-size;
+    return block;
+}
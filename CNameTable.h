@@ -0,0 +1,57 @@
+// Interned server name table for ParseCASW
+
+#ifndef _INC_CNAMETABLE_H
+#define _INC_CNAMETABLE_H
+
+#include <stddef.h>
+
+// Maps server names to small integer ids, which are assigned in the
+// order the names are first seen.  Lookups use the name bytes, their
+// length, and a precomputed hash, so the name does not need to be
+// copied or terminated.  The names are stored NUL terminated in a pool
+// of large blocks and do not move, so getName() pointers stay valid
+// for the life of the table.
+class CNameTable
+{
+  public:
+    CNameTable(int expected=0);
+    ~CNameTable(void);
+    static unsigned hash(const char *name, size_t len);
+    int lookup(const char *name, size_t len, unsigned hashVal) const;
+    int intern(const char *name, size_t len, unsigned hashVal);
+    void reserve(int expected);
+    const char *getName(int id) const { return names[id]; }
+    size_t getLength(int id) const { return lengths[id]; }
+    unsigned getHash(int id) const { return hashes[id]; }
+    int count(void) const { return nNames; }
+
+  private:
+    char *poolAlloc(size_t size);
+    void rehash(unsigned newSlots);
+    int *slots;
+    unsigned slotMask;
+    const char **names;
+    unsigned *hashes;
+    size_t *lengths;
+    int nNames;
+    int namesSize;
+    char **blocks;
+    int nBlocks;
+    int blocksSize;
+    char *poolCur;
+    size_t poolLeft;
+};
+
+// FNV-1a
+inline unsigned CNameTable::hash(const char *name, size_t len)
+{
+    unsigned h=2166136261u;
+
+    for(size_t i=0; i < len; i++) {
+	h^=(unsigned char)name[i];
+	h*=16777619u;
+    }
+    return h;
+}
+
+#endif // _INC_CNAMETABLE_H
@@ -0,0 +1,375 @@
+// Implementation of the buffered output of the reports for ParseCASW
+
+// A large offline report is hundreds of thousands of groups of a few
+// lines each, and printf with its locking and format parsing for every
+// field took most of the time.  The integers are formatted here
+// directly.  The fixed point numbers are too, except for the rare ones
+// that are within rounding error of a tie, or large, which are left to
+// snprintf so the digits are always the same as from printf.  The
+// times in a report are mostly in the same few seconds, so the last one
+// formatted is kept.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <math.h>
+
+#ifdef WIN32
+# include <io.h>
+#else
+# include <unistd.h>
+# include <sys/uio.h>
+#endif
+
+#include <epicsThread.h>
+#include <epicsStdio.h>
+
+#include "parsecasw.h"
+#include "utils.h"
+#include "COutput.h"
+
+// Format of the times
+#define OUTPUT_TIME_FORMAT "%b %d %H:%M:%S"
+
+// Largest value times 10^decimals that is formatted directly.  Up to
+// this the error in the product is much smaller than OUTPUT_TIE_WINDOW.
+#define OUTPUT_MAX_SCALED 1.e11
+
+// A fraction closer than this to .5 may round the other way in printf
+#define OUTPUT_TIE_WINDOW 1.e-4
+
+// Largest number of decimals that is formatted directly
+#define OUTPUT_MAX_DECIMALS 6
+
+static const double powersOf10[OUTPUT_MAX_DECIMALS+1]={
+    1.,10.,100.,1000.,10000.,100000.,1000000.
+};
+
+static void outputThread(void *arg);
+
+// Class COutput implementations
+
+COutput::COutput(void) :
+    fd(-1),
+    threadStarted(0),
+    curBuffer(-1),
+    cur(NULL),
+    end(NULL),
+    timeSec(0),
+    timeLen(0),
+    lock(NULL),
+    fullEvent(NULL),
+    freeEvent(NULL),
+    doneEvent(NULL),
+    fullHead(0),
+    nFull(0),
+    nWriting(0),
+    nFree(0),
+    ending(0),
+    status(P_OK)
+{
+    for(int i=0; i < OUTPUT_BUFFERS; i++) {
+	buffers[i]=NULL;
+	lengths[i]=0;
+    }
+}
+
+// The output must have been closed
+COutput::~COutput(void)
+{
+    for(int i=0; i < OUTPUT_BUFFERS; i++) {
+	if(buffers[i]) delete [] buffers[i];
+    }
+    if(lock) epicsMutexDestroy(lock);
+    if(fullEvent) epicsEventDestroy(fullEvent);
+    if(freeEvent) epicsEventDestroy(freeEvent);
+    if(doneEvent) epicsEventDestroy(doneEvent);
+}
+
+// Allocates the buffers and starts the writer thread for the file
+// descriptor, which is not closed.  Returns P_OK or P_ERROR.
+int COutput::open(int fdIn)
+{
+    fd=fdIn;
+    for(int i=0; i < OUTPUT_BUFFERS; i++) {
+	buffers[i]=new char[OUTPUT_BUFFER_SIZE];
+	if(!buffers[i]) {
+	    errMsg("Cannot allocate space for output buffers");
+	    exit(1);
+	}
+    }
+  // Fill the first buffer and keep the rest free
+    curBuffer=0;
+    cur=buffers[0];
+    end=cur+OUTPUT_BUFFER_SIZE;
+    nFree=0;
+    for(int i=OUTPUT_BUFFERS-1; i > 0; i--) freeList[nFree++]=i;
+
+    lock=epicsMutexMustCreate();
+    fullEvent=epicsEventCreate(epicsEventEmpty);
+    freeEvent=epicsEventCreate(epicsEventEmpty);
+    doneEvent=epicsEventCreate(epicsEventEmpty);
+    if(!fullEvent || !freeEvent || !doneEvent) return P_ERROR;
+    epicsThreadId tid=epicsThreadCreate("parsecaswWriter",
+      epicsThreadPriorityMedium,
+      epicsThreadGetStackSize(epicsThreadStackSmall),
+      outputThread,this);
+    if(!tid) return P_ERROR;
+    threadStarted=1;
+
+    return P_OK;
+}
+
+// Writes what is left and stops the writer thread
+void COutput::close(void)
+{
+    if(!threadStarted) return;
+    flush();
+    epicsMutexLock(lock);
+    ending=1;
+    epicsMutexUnlock(lock);
+    epicsEventSignal(fullEvent);
+    epicsEventWait(doneEvent);
+    threadStarted=0;
+}
+
+void COutput::put(const char *str)
+{
+    put(str,strlen(str));
+}
+
+// Copies the text, in pieces if it is longer than a buffer
+void COutput::put(const char *str, size_t len)
+{
+    while(len > 0) {
+	if(cur >= end) next();
+	size_t n=end-cur;
+	if(n > len) n=len;
+	memcpy(cur,str,n);
+	cur+=n;
+	str+=n;
+	len-=n;
+    }
+}
+
+// Puts an integer as %lld does
+void COutput::putInt(long long value)
+{
+    char digits[24];
+    int n=0;
+    unsigned long long uValue;
+
+    reserve(OUTPUT_ITEM_SIZE);
+    if(value < 0) {
+	*cur++='-';
+	uValue=0ULL-(unsigned long long)value;
+    } else {
+	uValue=(unsigned long long)value;
+    }
+    do {
+	digits[n++]=(char)('0'+uValue%10);
+	uValue/=10;
+    } while(uValue);
+    while(n > 0) *cur++=digits[--n];
+}
+
+// Puts a number as %.*f does with the given number of decimals
+void COutput::putFixed(double value, int decimals)
+{
+    reserve(OUTPUT_ITEM_SIZE);
+
+  // Leave zero, which may be negative, and the hard cases to snprintf
+    double absValue=(value < 0.)?-value:value;
+    if(decimals < 0 || decimals > OUTPUT_MAX_DECIMALS || value == 0. ||
+      !(absValue*powersOf10[decimals] < OUTPUT_MAX_SCALED)) {
+	int n=epicsSnprintf(cur,OUTPUT_ITEM_SIZE,"%.*f",decimals,value);
+	if(n > 0) cur+=(n < OUTPUT_ITEM_SIZE)?n:OUTPUT_ITEM_SIZE-1;
+	return;
+    }
+    double scaled=absValue*powersOf10[decimals];
+    double whole=floor(scaled);
+    double fraction=scaled-whole;
+    if(fabs(fraction-.5) < OUTPUT_TIE_WINDOW) {
+	int n=epicsSnprintf(cur,OUTPUT_ITEM_SIZE,"%.*f",decimals,value);
+	if(n > 0) cur+=(n < OUTPUT_ITEM_SIZE)?n:OUTPUT_ITEM_SIZE-1;
+	return;
+    }
+    unsigned long long rounded=(unsigned long long)whole;
+    if(fraction > .5) rounded++;
+
+  // The digits from the right, with the point after decimals of them
+    char digits[32];
+    int n=0;
+    for(int i=0; i < decimals; i++) {
+	digits[n++]=(char)('0'+rounded%10);
+	rounded/=10;
+    }
+    if(decimals > 0) digits[n++]='.';
+    do {
+	digits[n++]=(char)('0'+rounded%10);
+	rounded/=10;
+    } while(rounded);
+    if(value < 0.) *cur++='-';
+    while(n > 0) *cur++=digits[--n];
+}
+
+// Puts a time as month, day, and time of day.  It is formatted again
+// only when the second changes.
+void COutput::putTime(const epicsTime &time)
+{
+    epicsTimeStamp stamp=time;
+
+    if(!timeLen || stamp.secPastEpoch != timeSec) {
+	time.strftime(timeString,sizeof(timeString),OUTPUT_TIME_FORMAT);
+	timeSec=stamp.secPastEpoch;
+	timeLen=strlen(timeString);
+    }
+    put(timeString,timeLen);
+}
+
+// Formats as printf does, for what is not worth a special case.  The
+// result is cut at the end of a buffer.
+void COutput::format(const char *fmt, ...)
+{
+    va_list vargs;
+
+    if(end-cur < OUTPUT_BUFFER_SIZE/2) next();
+    va_start(vargs,fmt);
+    int n=epicsVsnprintf(cur,end-cur,fmt,vargs);
+    va_end(vargs);
+    if(n > 0) cur+=(n < end-cur)?n:end-cur-1;
+}
+
+// Waits until everything that has been put is written
+void COutput::flush(void)
+{
+    if(!threadStarted) return;
+    if(cur > buffers[curBuffer]) next();
+    epicsMutexLock(lock);
+    while(nFull > 0 || nWriting > 0) {
+	epicsMutexUnlock(lock);
+	epicsEventWait(freeEvent);
+	epicsMutexLock(lock);
+    }
+    epicsMutexUnlock(lock);
+}
+
+// Returns P_ERROR if a write has failed, else P_OK
+int COutput::getStatus(void) const
+{
+    if(!lock) return status;
+    epicsMutexLock(lock);
+    int curStatus=status;
+    epicsMutexUnlock(lock);
+
+    return curStatus;
+}
+
+// Queues the current buffer to be written and takes a free one,
+// waiting for the writer if there is none
+void COutput::next(void)
+{
+    epicsMutexLock(lock);
+    lengths[curBuffer]=cur-buffers[curBuffer];
+    full[(fullHead+nFull)%OUTPUT_BUFFERS]=curBuffer;
+    nFull++;
+    epicsEventSignal(fullEvent);
+    while(nFree == 0) {
+	epicsMutexUnlock(lock);
+	epicsEventWait(freeEvent);
+	epicsMutexLock(lock);
+    }
+    curBuffer=freeList[--nFree];
+    epicsMutexUnlock(lock);
+
+    cur=buffers[curBuffer];
+    end=cur+OUTPUT_BUFFER_SIZE;
+}
+
+// The writer thread.  It writes all the full buffers at once and frees
+// them, until close().
+void COutput::run(void)
+{
+    int ids[OUTPUT_BUFFERS];
+    int nIds,isEnding,writeStatus;
+
+    for(;;) {
+	epicsMutexLock(lock);
+	nIds=0;
+	while(nFull > 0) {
+	    ids[nIds++]=full[fullHead];
+	    fullHead=(fullHead+1)%OUTPUT_BUFFERS;
+	    nFull--;
+	}
+	nWriting=nIds;
+	isEnding=ending;
+	writeStatus=status;
+	epicsMutexUnlock(lock);
+
+	if(!nIds) {
+	    if(isEnding) break;
+	    epicsEventWait(fullEvent);
+	    continue;
+	}
+
+      // After an error the output is discarded
+	if(writeStatus == P_OK) {
+#ifdef WIN32
+	    for(int i=0; i < nIds && writeStatus == P_OK; i++) {
+		const char *p=buffers[ids[i]];
+		size_t left=lengths[ids[i]];
+		while(left > 0) {
+		    int n=_write(fd,p,(unsigned)left);
+		    if(n < 0) {
+			writeStatus=P_ERROR;
+			break;
+		    }
+		    p+=n;
+		    left-=n;
+		}
+	    }
+#else
+	    struct iovec iov[OUTPUT_BUFFERS];
+	    int first=0;
+	    for(int i=0; i < nIds; i++) {
+		iov[i].iov_base=buffers[ids[i]];
+		iov[i].iov_len=lengths[ids[i]];
+	    }
+	  // A partial write leaves the rest in the first vectors
+	    while(first < nIds) {
+		ssize_t n=writev(fd,iov+first,nIds-first);
+		if(n < 0) {
+		    if(errno == EINTR) continue;
+		    writeStatus=P_ERROR;
+		    break;
+		}
+		while(first < nIds && (size_t)n >= iov[first].iov_len) {
+		    n-=iov[first].iov_len;
+		    first++;
+		}
+		if(first < nIds) {
+		    iov[first].iov_base=(char *)iov[first].iov_base+n;
+		    iov[first].iov_len-=n;
+		}
+	    }
+#endif
+	}
+
+	epicsMutexLock(lock);
+	for(int i=0; i < nIds; i++) freeList[nFree++]=ids[i];
+	nWriting=0;
+	status=writeStatus;
+	epicsMutexUnlock(lock);
+	epicsEventSignal(freeEvent);
+    }
+
+    epicsEventSignal(doneEvent);
+}
+
+static void outputThread(void *arg)
+{
+    COutput *pOutput=(COutput *)arg;
+
+    pOutput->run();
+}
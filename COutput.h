@@ -0,0 +1,84 @@
+// Buffered output of the reports for ParseCASW
+
+#ifndef _INC_COUTPUT_H
+#define _INC_COUTPUT_H
+
+#include <stddef.h>
+
+#include <epicsTime.h>
+#include <epicsMutex.h>
+#include <epicsEvent.h>
+
+// Size and number of the buffers.  A report fills one while the writer
+// thread writes the others.
+#define OUTPUT_BUFFER_SIZE 262144
+#define OUTPUT_BUFFERS 4
+
+// Room that is made at the end of the buffer for one number or time
+#define OUTPUT_ITEM_SIZE 64
+
+// Reports are formatted into large buffers that are reused, and a
+// writer thread writes the full ones to the file descriptor with one
+// writev, so formatting a report and writing it overlap and there is no
+// stdio call per field.  The numbers are formatted here the same as
+// printf formats them.  Only one thread at a time may put text, and it
+// must flush() before it prints with stdio, and fflush(stdout) before
+// it puts text after stdio, so the two stay in order.  If another
+// thread can print to stdout meanwhile, hold its lock with flockfile()
+// from the fflush(stdout) through the flush().  If the writer
+// has all the buffers, put waits for one, which keeps the memory fixed.
+class COutput
+{
+  public:
+    COutput(void);
+    ~COutput(void);
+    int open(int fd);
+    void close(void);
+    int isOpen(void) const { return threadStarted; }
+    void put(const char *str);
+    void put(const char *str, size_t len);
+    void putChar(char c) {
+	if(cur >= end) next();
+	*cur++=c;
+    }
+    void putInt(long long value);
+    void putFixed(double value, int decimals);
+    void putTime(const epicsTime &time);
+    void format(const char *fmt, ...);
+    void flush(void);
+    int getStatus(void) const;
+    void run(void);
+
+  private:
+    void reserve(size_t len) { if(cur+len > end) next(); }
+    void next(void);
+
+    int fd;
+    int threadStarted;
+    char *buffers[OUTPUT_BUFFERS];
+    size_t lengths[OUTPUT_BUFFERS];
+  // The buffer being filled
+    int curBuffer;
+    char *cur;
+    char *end;
+  // The last time that was formatted
+    epicsUInt32 timeSec;
+    char timeString[OUTPUT_ITEM_SIZE];
+    size_t timeLen;
+  // Protected by lock.  The full buffers are a ring in the order they
+  // are to be written, and the free ones are a stack.
+    epicsMutexId lock;
+    epicsEventId fullEvent;
+    epicsEventId freeEvent;
+    epicsEventId doneEvent;
+    int full[OUTPUT_BUFFERS];
+    int fullHead;
+    int nFull;
+    int nWriting;
+    int freeList[OUTPUT_BUFFERS];
+    int nFree;
+    int ending;
+    int status;
+};
+
+#endif // _INC_COUTPUT_H
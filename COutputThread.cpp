@@ -0,0 +1,172 @@
+// Implementation of the snapshots of finished groups and the thread
+// that prints them for ParseCASW
+
+// The timer used to print the finished groups with the shards paused,
+// so a slow terminal or a full pipe stopped the input as long as it
+// took to write them.  Now only the summaries are taken while they are
+// paused, and the printing is done here.
+
+#include <stdlib.h>
+
+#include <epicsThread.h>
+
+#include "parsecasw.h"
+#include "utils.h"
+#include "COutputThread.h"
+
+static void outputThread(void *arg);
+
+// Class CSnapshot implementations
+
+// The size is the number of groups it will hold, and nStats is the
+// number of buffers of statsSize for the usage of the shards, which is
+// 0 if it is not kept
+CSnapshot::CSnapshot(int sizeIn, int nStatsIn, size_t statsSizeIn) :
+    names(NULL),
+    summaries(NULL),
+    size(sizeIn),
+    nEntries(0),
+    stats(NULL),
+    nStats(nStatsIn),
+    statsSize(statsSizeIn),
+    holdTime(0.0),
+    next(NULL)
+{
+    if(size > 0) {
+	names=new const char *[size];
+	summaries=new GroupSummary[size];
+	if(!names || !summaries) {
+	    errMsg("Cannot allocate space for snapshot");
+	    exit(1);
+	}
+    }
+    if(nStats > 0) {
+	stats=new char[nStats*statsSize];
+	if(!stats) {
+	    errMsg("Cannot allocate space for snapshot statistics");
+	    exit(1);
+	}
+	for(int i=0; i < nStats; i++) stats[i*statsSize]='\0';
+    }
+}
+
+CSnapshot::~CSnapshot(void)
+{
+    if(names) delete [] names;
+    if(summaries) delete [] summaries;
+    if(stats) delete [] stats;
+}
+
+// Adds a group.  There must be room for it.
+void CSnapshot::add(const char *name, const GroupSummary &summary)
+{
+    names[nEntries]=name;
+    summaries[nEntries]=summary;
+    nEntries++;
+}
+
+// Class COutputThread implementations
+
+COutputThread::COutputThread(SnapshotPrinter printerIn) :
+    printer(printerIn),
+    lock(NULL),
+    wakeEvent(NULL),
+    doneEvent(NULL),
+    threadStarted(0),
+    first(NULL),
+    last(NULL),
+    ending(0)
+{
+    lock=epicsMutexMustCreate();
+}
+
+// The thread must have finished
+COutputThread::~COutputThread(void)
+{
+    while(first) {
+	CSnapshot *pSnapshot=first;
+	first=pSnapshot->getNext();
+	delete pSnapshot;
+    }
+    if(lock) epicsMutexDestroy(lock);
+    if(wakeEvent) epicsEventDestroy(wakeEvent);
+    if(doneEvent) epicsEventDestroy(doneEvent);
+}
+
+// Starts the thread.  Returns P_OK or P_ERROR.
+int COutputThread::start(void)
+{
+    wakeEvent=epicsEventCreate(epicsEventEmpty);
+    doneEvent=epicsEventCreate(epicsEventEmpty);
+    if(!wakeEvent || !doneEvent) return P_ERROR;
+    epicsThreadId tid=epicsThreadCreate("parsecaswOutput",
+      epicsThreadPriorityLow,
+      epicsThreadGetStackSize(epicsThreadStackMedium),
+      outputThread,this);
+    if(!tid) return P_ERROR;
+    threadStarted=1;
+
+    return P_OK;
+}
+
+// The output thread.  It prints the snapshots until finish() is called
+// and there are none left.
+void COutputThread::run(void)
+{
+    CSnapshot *pList;
+    int isEnding;
+
+    for(;;) {
+      // Take the whole list
+	epicsMutexLock(lock);
+	pList=first;
+	first=last=NULL;
+	isEnding=ending;
+	epicsMutexUnlock(lock);
+
+	if(!pList) {
+	    if(isEnding) break;
+	    epicsEventWait(wakeEvent);
+	    continue;
+	}
+	while(pList) {
+	    CSnapshot *pSnapshot=pList;
+	    pList=pSnapshot->getNext();
+	    printer(*pSnapshot);
+	    delete pSnapshot;
+	}
+    }
+
+    epicsEventSignal(doneEvent);
+}
+
+// Queues a snapshot to be printed.  The thread deletes it.
+void COutputThread::queue(CSnapshot *pSnapshot)
+{
+    pSnapshot->setNext(NULL);
+    epicsMutexLock(lock);
+    if(last) last->setNext(pSnapshot);
+    else first=pSnapshot;
+    last=pSnapshot;
+    epicsMutexUnlock(lock);
+    epicsEventSignal(wakeEvent);
+}
+
+// Waits for the queued snapshots to be printed and the thread to end
+void COutputThread::finish(void)
+{
+    if(!threadStarted) return;
+    epicsMutexLock(lock);
+    ending=1;
+    epicsMutexUnlock(lock);
+    epicsEventSignal(wakeEvent);
+    epicsEventWait(doneEvent);
+    threadStarted=0;
+}
+
+static void outputThread(void *arg)
+{
+    COutputThread *pThread=(COutputThread *)arg;
+
+    pThread->run();
+}
@@ -0,0 +1,79 @@
+// Snapshots of finished groups and the thread that prints them for
+// ParseCASW
+
+#ifndef _INC_COUTPUTTHREAD_H
+#define _INC_COUTPUTTHREAD_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <epicsMutex.h>
+#include <epicsEvent.h>
+
+#include "CSummaryStore.h"
+
+// The finished groups from one timer expiration in the order they are
+// to be printed, with everything needed to print them, so they can be
+// printed after the shards are resumed.  The names are those of the
+// CNameTable, which do not move.  The usage of the stores of each
+// shard can be kept as it was when the groups were taken.
+class CSnapshot
+{
+  public:
+    CSnapshot(int size, int nStats, size_t statsSize);
+    ~CSnapshot(void);
+    void add(const char *name, const GroupSummary &summary);
+    int getCount(void) const { return nEntries; }
+    const char *getName(int i) const { return names[i]; }
+    const GroupSummary &getSummary(int i) const { return summaries[i]; }
+    int getStatsCount(void) const { return nStats; }
+    char *getStats(int i) { return stats+i*statsSize; }
+    const char *getStats(int i) const { return stats+i*statsSize; }
+    size_t getStatsSize(void) const { return statsSize; }
+    double getHoldTime(void) const { return holdTime; }
+    void setHoldTime(double time) { holdTime=time; }
+    CSnapshot *getNext(void) const { return next; }
+    void setNext(CSnapshot *pSnapshot) { next=pSnapshot; }
+
+  private:
+    const char **names;
+    GroupSummary *summaries;
+    int size;
+    int nEntries;
+    char *stats;
+    int nStats;
+    size_t statsSize;
+    double holdTime;
+    CSnapshot *next;
+};
+
+typedef void (*SnapshotPrinter)(const CSnapshot &snapshot);
+
+// A thread that prints the snapshots queued to it in order and deletes
+// them.  The queue is a list under a lock that is only held to link or
+// unlink the snapshots, so the thread that queues them never waits for
+// the printing, however slow the output is.
+class COutputThread
+{
+  public:
+    COutputThread(SnapshotPrinter printer);
+    ~COutputThread(void);
+    int start(void);
+    void run(void);
+    int isStarted(void) const { return threadStarted; }
+    void queue(CSnapshot *pSnapshot);
+    void finish(void);
+
+  private:
+    SnapshotPrinter printer;
+    epicsMutexId lock;
+    epicsEventId wakeEvent;
+    epicsEventId doneEvent;
+    int threadStarted;
+  // Protected by lock
+    CSnapshot *first;
+    CSnapshot *last;
+    int ending;
+};
+
+#endif // _INC_COUTPUTTHREAD_H
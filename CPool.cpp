@@ -0,0 +1,113 @@
+// Implementation of pools of fixed size objects for ParseCASW
+
+// In real-time mode servers are made as beacons arrive and deleted
+// when all their groups have been reported, for as long as the program
+// runs.  Taking them from slabs keeps them together instead of spread
+// over the heap, and the memory used stays at the high-water mark
+// instead of growing with fragmentation.
+
+#include <stdlib.h>
+
+#include <epicsStdio.h>
+
+#include "utils.h"
+#include "CPool.h"
+
+// Objects are rounded up to a multiple of this so each one is aligned
+// for a double
+#define POOL_ALIGN 8
+
+// Initial size of the slab array, which doubles as needed
+#define POOL_SLAB_ARRAY_SIZE 16
+
+// Class CPool implementations
+
+CPool::CPool(const char *nameIn, size_t objectSizeIn) :
+    name(nameIn),
+    objectSize(objectSizeIn),
+    freeList(NULL),
+    slabs(NULL),
+    nSlabs(0),
+    slabsSize(0),
+    nextSlabObjects(POOL_SLAB_OBJECTS),
+    capacity(0),
+    nInUse(0),
+    highWater(0)
+{
+    if(objectSize < sizeof(FreeItem)) objectSize=sizeof(FreeItem);
+    objectSize=(objectSize+POOL_ALIGN-1)/POOL_ALIGN*POOL_ALIGN;
+}
+
+CPool::~CPool(void)
+{
+    for(int i=0; i < nSlabs; i++) delete [] slabs[i];
+    if(slabs) delete [] slabs;
+}
+
+// Returns an uninitialized object.  It does not return if there is no
+// memory.
+void *CPool::allocate(void)
+{
+    FreeItem *pItem;
+
+    if(!freeList) addSlab();
+    pItem=freeList;
+    freeList=pItem->next;
+    if(++nInUse > highWater) highWater=nInUse;
+
+    return pItem;
+}
+
+// Puts an object from allocate() back on the free list
+void CPool::release(void *p)
+{
+    if(!p) return;
+    FreeItem *pItem=(FreeItem *)p;
+
+    pItem->next=freeList;
+    freeList=pItem;
+    nInUse--;
+}
+
+// Adds a slab and puts its objects on the free list
+void CPool::addSlab(void)
+{
+    if(nSlabs >= slabsSize) {
+	int newSize=slabsSize?2*slabsSize:POOL_SLAB_ARRAY_SIZE;
+	char **newSlabs=new char *[newSize];
+	if(!newSlabs) {
+	    errMsg("Cannot allocate space for %s pool slab array",name);
+	    exit(1);
+	}
+	for(int i=0; i < nSlabs; i++) newSlabs[i]=slabs[i];
+	if(slabs) delete [] slabs;
+	slabs=newSlabs;
+	slabsSize=newSize;
+    }
+
+    unsigned nObjects=nextSlabObjects;
+    char *slab=new char[nObjects*objectSize];
+    if(!slab) {
+	errMsg("Cannot allocate space for %s pool",name);
+	exit(1);
+    }
+    slabs[nSlabs++]=slab;
+    capacity+=nObjects;
+    if(nextSlabObjects < POOL_MAX_SLAB_OBJECTS) nextSlabObjects*=2;
+
+  // Link them in address order
+    for(unsigned i=nObjects; i > 0; i--) {
+	FreeItem *pItem=(FreeItem *)(slab+(i-1)*objectSize);
+	pItem->next=freeList;
+	freeList=pItem;
+    }
+}
+
+// Formats one line with the usage of the pool into buf, so it can be
+// taken while the pool is not changing and printed later
+void CPool::formatStats(char *buf, size_t bufSize) const
+{
+    epicsSnprintf(buf,bufSize,"%s pool: %u in use, %u high water, "
+      "%u allocated in %d slab(s) (%.1f KiB)\n",name,nInUse,highWater,
+      capacity,nSlabs,getBytes()/1024.);
+}
@@ -0,0 +1,54 @@
+// Pools of fixed size objects for ParseCASW
+
+#ifndef _INC_CPOOL_H
+#define _INC_CPOOL_H
+
+#include <stddef.h>
+
+// Number of objects in the first slab.  Each new slab is twice the
+// size of the last one, up to POOL_MAX_SLAB_OBJECTS.
+#define POOL_SLAB_OBJECTS 256
+#define POOL_MAX_SLAB_OBJECTS 65536
+
+// Objects of one size are allocated from slabs and kept on a free list
+// when released, so a released object is reused in O(1) and the slabs
+// are never returned until the pool is destroyed.  Each CGroupStore
+// has a pool for its servers and one for its sketches, which are only
+// used by the thread that owns the store, so a pool is not locked.
+class CPool
+{
+  public:
+    CPool(const char *name, size_t objectSize);
+    ~CPool(void);
+    void *allocate(void);
+    void release(void *p);
+    const char *getName(void) const { return name; }
+    unsigned getInUse(void) const { return nInUse; }
+    unsigned getHighWater(void) const { return highWater; }
+    unsigned getCapacity(void) const { return capacity; }
+    int getSlabCount(void) const { return nSlabs; }
+    size_t getBytes(void) const { return (size_t)capacity*objectSize; }
+    void formatStats(char *buf, size_t bufSize) const;
+
+  private:
+    void addSlab(void);
+
+  // A released object holds the link to the next one
+    struct FreeItem
+    {
+	FreeItem *next;
+    };
+
+    const char *name;
+    size_t objectSize;
+    FreeItem *freeList;
+    char **slabs;
+    int nSlabs;
+    int slabsSize;
+    unsigned nextSlabObjects;
+    unsigned capacity;
+    unsigned nInUse;
+    unsigned highWater;
+};
+
+#endif // _INC_CPOOL_H
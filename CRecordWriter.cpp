@@ -0,0 +1,112 @@
+// Implementation of the machine-readable records of the reports for
+// ParseCASW
+
+// Strings are escaped as JSON requires, or quoted for CSV only when
+// they have a comma, quote, or line break, which server names do not
+// normally have.  The numbers are integers, so they are written by the
+// integer formatter of COutput and are exact.
+
+#include "CRecordWriter.h"
+
+static const char hexDigits[]="0123456789abcdef";
+
+// Class CRecordWriter implementations
+
+CRecordWriter::CRecordWriter(COutput &outputIn) :
+    output(outputIn),
+    format(RF_TEXT),
+    columns(NULL),
+    nColumns(0),
+    column(0),
+    headerColumns(NULL)
+{
+}
+
+// Starts a record with these columns.  The CSV header is written if
+// they are not the ones it was last written for.
+void CRecordWriter::begin(const char *const *columnsIn, int nColumnsIn)
+{
+    columns=columnsIn;
+    nColumns=nColumnsIn;
+    column=0;
+
+    if(format == RF_CSV && headerColumns != columns) {
+	for(int i=0; i < nColumns; i++) {
+	    if(i > 0) output.putChar(',');
+	    output.put(columns[i]);
+	}
+	output.putChar('\n');
+	headerColumns=columns;
+    }
+}
+
+// Writes what comes before the value of the next field
+void CRecordWriter::startField(void)
+{
+    if(format == RF_JSONL) {
+	output.put(column?",\"":"{\"");
+	output.put(columns[column]);
+	output.put("\":");
+    } else if(column > 0) {
+	output.putChar(',');
+    }
+    column++;
+}
+
+void CRecordWriter::putString(const char *value)
+{
+    const char *p;
+
+    startField();
+    if(format == RF_JSONL) {
+	output.putChar('"');
+	for(p=value; *p; p++) {
+	    unsigned char c=(unsigned char)*p;
+	    if(c == '"' || c == '\\') {
+		output.putChar('\\');
+		output.putChar((char)c);
+	    } else if(c < 0x20) {
+		output.put("\\u00");
+		output.putChar(hexDigits[c >> 4]);
+		output.putChar(hexDigits[c & 0xf]);
+	    } else {
+		output.putChar((char)c);
+	    }
+	}
+	output.putChar('"');
+    } else {
+	for(p=value; *p; p++) {
+	    if(*p == ',' || *p == '"' || *p == '\n' || *p == '\r') break;
+	}
+	if(!*p) {
+	    output.put(value);
+	    return;
+	}
+	output.putChar('"');
+	for(p=value; *p; p++) {
+	    if(*p == '"') output.putChar('"');
+	    output.putChar(*p);
+	}
+	output.putChar('"');
+    }
+}
+
+void CRecordWriter::putInt(long long value)
+{
+    startField();
+    output.putInt(value);
+}
+
+// Puts a field with no value, which is null in JSON and empty in CSV
+void CRecordWriter::putNull(void)
+{
+    startField();
+    if(format == RF_JSONL) output.put("null");
+}
+
+// Ends the record and its line
+void CRecordWriter::end(void)
+{
+    if(format == RF_JSONL) output.putChar('}');
+    output.putChar('\n');
+}
@@ -0,0 +1,43 @@
+// Machine-readable records of the reports for ParseCASW
+
+#ifndef _INC_CRECORDWRITER_H
+#define _INC_CRECORDWRITER_H
+
+#include "COutput.h"
+
+typedef enum _ReportFormat {
+    RF_TEXT,
+    RF_JSONL,
+    RF_CSV
+} ReportFormat;
+
+// Writes records of named fields as JSON Lines, one object per line,
+// or as CSV, with a header line before the first record.  The fields of
+// a record are put in the order of the column names given to begin(),
+// which are the JSON keys and the CSV header.  The text goes straight
+// into the output buffers, and nothing is allocated.
+class CRecordWriter
+{
+  public:
+    CRecordWriter(COutput &output);
+    void setFormat(ReportFormat formatIn) { format=formatIn; }
+    ReportFormat getFormat(void) const { return format; }
+    void begin(const char *const *columns, int nColumns);
+    void putString(const char *value);
+    void putInt(long long value);
+    void putNull(void);
+    void end(void);
+
+  private:
+    void startField(void);
+
+    COutput &output;
+    ReportFormat format;
+    const char *const *columns;
+    int nColumns;
+    int column;
+  // The columns of the last CSV header
+    const char *const *headerColumns;
+};
+
+#endif // _INC_CRECORDWRITER_H
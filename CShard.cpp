@@ -0,0 +1,203 @@
+// Implementation of the shards of the servers and their groups for
+// ParseCASW
+
+// The reader routes each event to the shard for the hash of its server
+// name, so all the events of a server are added in order by one
+// thread, and the groups are the same as with one shard.  A report
+// pauses the workers at a point between events and uses the shards
+// directly.  The reader keeps filling the rings while they are paused.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <epicsAtomic.h>
+#include <epicsThread.h>
+#include <epicsStdio.h>
+
+#include "parsecasw.h"
+#include "utils.h"
+#include "CShard.h"
+
+static void shardThread(void *arg);
+
+// Class CShard implementations
+
+CShard::CShard(double newGroupTimeIn, size_t maxMemIn) :
+    newGroupTime(newGroupTimeIn),
+    maxMem(maxMemIn),
+    compactThreshold(maxMemIn),
+    nCompactions(0),
+    pRing(NULL),
+    threadStarted(0),
+    pauseRequested(0),
+    pausedEvent(NULL),
+    resumeEvent(NULL),
+    doneEvent(NULL)
+{
+}
+
+// The worker must have finished
+CShard::~CShard(void)
+{
+  // Delete the CIocs, which removes their groups
+    for(int id=0; id < iocTable.getSize(); id++) {
+	CIoc *pIoc=iocTable.lookup(id);
+	if(!pIoc) continue;
+	iocTable.remove(*pIoc);
+	CIoc::destroy(pIoc);
+    }
+    if(pRing) delete pRing;
+    if(pausedEvent) epicsEventDestroy(pausedEvent);
+    if(resumeEvent) epicsEventDestroy(resumeEvent);
+    if(doneEvent) epicsEventDestroy(doneEvent);
+}
+
+// Starts the worker thread.  Returns P_OK or P_ERROR.
+int CShard::start(void)
+{
+    pRing=new CEventRing;
+    if(!pRing) {
+	errMsg("Cannot allocate space for event ring");
+	exit(1);
+    }
+    pausedEvent=epicsEventCreate(epicsEventEmpty);
+    resumeEvent=epicsEventCreate(epicsEventEmpty);
+    doneEvent=epicsEventCreate(epicsEventEmpty);
+    if(!pausedEvent || !resumeEvent || !doneEvent) return P_ERROR;
+    epicsThreadId tid=epicsThreadCreate("parsecaswShard",
+      epicsThreadPriorityMedium,
+      epicsThreadGetStackSize(epicsThreadStackMedium),
+      shardThread,this);
+    if(!tid) return P_ERROR;
+    threadStarted=1;
+
+    return P_OK;
+}
+
+// The worker thread.  It adds the events from the ring until the end
+// record.
+void CShard::run(void)
+{
+    RingRecord record;
+
+    for(;;) {
+	if(epicsAtomicGetIntT(&pauseRequested)) {
+	    epicsEventSignal(pausedEvent);
+	    epicsEventWait(resumeEvent);
+	    continue;
+	}
+	if(!pRing->pop(record)) {
+	    pRing->wait();
+	    continue;
+	}
+	if(record.type == RR_END) break;
+	addEvent(record.name,record.id,record.time,record.lineNum);
+    }
+
+    epicsEventSignal(doneEvent);
+}
+
+// Waits until the worker is stopped between events.  The shard can
+// then be used by the calling thread until resume().
+void CShard::pause(void)
+{
+    if(!threadStarted) return;
+    epicsAtomicSetIntT(&pauseRequested,1);
+    pRing->signal();
+    epicsEventWait(pausedEvent);
+}
+
+void CShard::resume(void)
+{
+    if(!threadStarted) return;
+    epicsAtomicSetIntT(&pauseRequested,0);
+    epicsEventSignal(resumeEvent);
+}
+
+// Waits for the worker to add the rest of the events and end.  The
+// shard then belongs to the calling thread.
+void CShard::finish(void)
+{
+    RingRecord record;
+
+    if(!threadStarted) return;
+    record.type=RR_END;
+    pRing->pushWait(record);
+    epicsEventWait(doneEvent);
+    threadStarted=0;
+}
+
+// Adds an event to the servers and groups.  The name is the interned
+// one for the id.
+void CShard::addEvent(const char *name, int id, epicsTime time,
+  int lineNum)
+{
+    CIoc *pIoc=iocTable.lookup(id);
+    if(pIoc) {
+	pIoc->update(time,newGroupTime);
+    } else {
+	pIoc=new(groupStore) CIoc(name,id,time,groupStore);
+	if(!pIoc) {
+	    errMsg("Failed to create IOC entry for line %d: %s",
+	      lineNum,name);
+	    exit(1);
+	}
+	iocTable.add(*pIoc);
+    }
+
+  // Compact the finished groups if they and the summaries are over the
+  // budget
+    if(maxMem && getUsedBytes() > compactThreshold) compact();
+}
+
+// Returns the size of the groups in use and of the summaries
+size_t CShard::getUsedBytes(void) const
+{
+    return groupStore.getUsedBytes()+summaryStore.getBytes();
+}
+
+// Replaces the finished groups of all the servers with summaries.  The
+// current groups and the summaries cannot be compacted, so if they are
+// still more than half the budget the next compaction waits until they
+// have doubled, which keeps the cost linear in the number of groups.
+void CShard::compact(void)
+{
+    for(int id=0; id < iocTable.getSize(); id++) {
+	CIoc *pIoc=iocTable.lookup(id);
+	if(pIoc) pIoc->compact(summaryStore);
+    }
+    nCompactions++;
+
+    size_t bytes=getUsedBytes();
+    compactThreshold=(2*bytes > maxMem)?2*bytes:maxMem;
+}
+
+// Formats the lines with the usage of the stores into buf.  The shard
+// must be paused or finished.
+void CShard::formatStats(char *buf, size_t bufSize) const
+{
+    groupStore.formatStats(buf,bufSize);
+    if(maxMem) {
+	size_t len=strlen(buf);
+	summaryStore.formatStats(buf+len,bufSize-len);
+	len=strlen(buf);
+	epicsSnprintf(buf+len,bufSize-len,"Compactions: %d\n",nCompactions);
+    }
+}
+
+// Prints the usage of the stores and the ring
+void CShard::printStats(FILE *fp) const
+{
+    char buf[SHARD_STATS_SIZE];
+
+    formatStats(buf,sizeof(buf));
+    fputs(buf,fp);
+    if(pRing) pRing->printStats(fp);
+}
+
+static void shardThread(void *arg)
+{
+    CShard *pShard=(CShard *)arg;
+
+    pShard->run();
+}
@@ -0,0 +1,68 @@
+// Shards of the servers and their groups for ParseCASW
+
+#ifndef _INC_CSHARD_H
+#define _INC_CSHARD_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <epicsTime.h>
+#include <epicsEvent.h>
+
+#include "CIoc.h"
+#include "CGroupStore.h"
+#include "CSummaryStore.h"
+#include "CEventRing.h"
+
+// Size of the buffer for the formatted usage of the stores of a shard
+#define SHARD_STATS_SIZE 512
+
+// The servers whose names hash to one shard, with their groups and the
+// summaries of their compacted groups.  The ids are those of the one
+// CNameTable, so a server has the same id in every shard, and it is
+// only in one shard.  A shard is updated by addEvent() on the calling
+// thread, or after start() by its own worker thread from the events in
+// its ring.  The worker is the only thread that uses the shard until
+// it is paused or finished, so the shard has no lock.
+class CShard
+{
+  public:
+    CShard(double newGroupTime, size_t maxMem);
+    ~CShard(void);
+    int start(void);
+    void run(void);
+    int isStarted(void) const { return threadStarted; }
+    CEventRing &getRing(void) { return *pRing; }
+    void pause(void);
+    void resume(void);
+    void finish(void);
+    void addEvent(const char *name, int id, epicsTime time, int lineNum);
+    CIocTable &getIocTable(void) { return iocTable; }
+    CGroupStore &getGroupStore(void) { return groupStore; }
+    CSummaryStore &getSummaryStore(void) { return summaryStore; }
+    unsigned getDrops(void) const { return pRing?pRing->getDrops():0; }
+    void formatStats(char *buf, size_t bufSize) const;
+    void printStats(FILE *fp) const;
+
+  private:
+    size_t getUsedBytes(void) const;
+    void compact(void);
+
+    double newGroupTime;
+    size_t maxMem;
+    size_t compactThreshold;
+    int nCompactions;
+    CIocTable iocTable;
+    CGroupStore groupStore;
+    CSummaryStore summaryStore;
+
+  // Worker thread
+    CEventRing *pRing;
+    int threadStarted;
+    int pauseRequested;
+    epicsEventId pausedEvent;
+    epicsEventId resumeEvent;
+    epicsEventId doneEvent;
+};
+
+#endif // _INC_CSHARD_H
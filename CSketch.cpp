@@ -0,0 +1,187 @@
+// Implementation of the quantile sketch of intervals for ParseCASW
+
+// The bucket of a value comes from its binary exponent and the top of
+// its mantissa, as given by frexp, so no logarithm is needed.  Within
+// a power of 2 the buckets are of equal width.  A quantile is
+// reported as the middle of its bucket.  The intervals of a group are
+// mostly in one or two buckets, so the buckets with values are found
+// by a linear search, and the array of a sketch that outgrows the
+// inline one is allocated only then.  add() and merge() return the
+// bytes they allocated, so the group store can count them.
+
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+
+#include "utils.h"
+#include "CSketch.h"
+
+// Class CSketch implementations
+
+CSketch::CSketch(void) :
+    count(0),
+    min(DBL_MAX),
+    max(-DBL_MAX),
+    nBuckets(0),
+    bucketsSize(SKETCH_INLINE_BUCKETS),
+    buckets(inlineBuckets),
+    counts(inlineCounts)
+{
+}
+
+CSketch::CSketch(const CSketch &sketch) :
+    count(sketch.count),
+    min(sketch.min),
+    max(sketch.max),
+    nBuckets(0),
+    bucketsSize(SKETCH_INLINE_BUCKETS),
+    buckets(inlineBuckets),
+    counts(inlineCounts)
+{
+    while(bucketsSize < sketch.nBuckets) grow();
+    for(int i=0; i < sketch.nBuckets; i++) {
+	buckets[i]=sketch.buckets[i];
+	counts[i]=sketch.counts[i];
+    }
+    nBuckets=sketch.nBuckets;
+}
+
+CSketch::~CSketch(void)
+{
+    if(buckets != inlineBuckets) {
+	delete [] buckets;
+	delete [] counts;
+    }
+}
+
+// Returns the bytes of the arrays that are not in the sketch itself
+size_t CSketch::getExtraBytes(void) const
+{
+    if(buckets == inlineBuckets) return 0;
+    return (size_t)bucketsSize*(sizeof(unsigned char)+sizeof(unsigned));
+}
+
+// Doubles the size of the arrays.  Returns the bytes it allocated.
+size_t CSketch::grow(void)
+{
+    size_t oldBytes=getExtraBytes();
+    int newSize=2*bucketsSize;
+    if(newSize > SKETCH_NBUCKETS) newSize=SKETCH_NBUCKETS;
+    unsigned char *newBuckets=new unsigned char[newSize];
+    unsigned *newCounts=new unsigned[newSize];
+    if(!newBuckets || !newCounts) {
+	errMsg("Cannot allocate space for sketch buckets");
+	exit(1);
+    }
+    for(int i=0; i < nBuckets; i++) {
+	newBuckets[i]=buckets[i];
+	newCounts[i]=counts[i];
+    }
+    if(buckets != inlineBuckets) {
+	delete [] buckets;
+	delete [] counts;
+    }
+    buckets=newBuckets;
+    counts=newCounts;
+    bucketsSize=newSize;
+
+    return getExtraBytes()-oldBytes;
+}
+
+// Adds n to the count of a bucket, inserting it in order if it has no
+// values yet.  Returns the bytes it allocated.
+size_t CSketch::addCount(int bucket, unsigned n)
+{
+    size_t grown=0;
+    int i;
+
+    for(i=0; i < nBuckets && buckets[i] < bucket; i++) ;
+    if(i < nBuckets && buckets[i] == bucket) {
+	counts[i]+=n;
+	return 0;
+    }
+    if(nBuckets >= bucketsSize) grown=grow();
+    for(int j=nBuckets; j > i; j--) {
+	buckets[j]=buckets[j-1];
+	counts[j]=counts[j-1];
+    }
+    buckets[i]=(unsigned char)bucket;
+    counts[i]=n;
+    nBuckets++;
+
+    return grown;
+}
+
+// Returns the bucket for a value
+int CSketch::getBucket(double value)
+{
+    int exp;
+
+    if(!(value >= 1.0/(double)(1 << -SKETCH_MIN_EXP))) return 0;
+  // value=mantissa*2^exp with the mantissa in [0.5,1)
+    double mantissa=frexp(value,&exp);
+    int octave=exp-1-SKETCH_MIN_EXP;
+    if(octave >= SKETCH_MAX_EXP-SKETCH_MIN_EXP) return SKETCH_NBUCKETS-1;
+    int sub=(int)((mantissa-0.5)*(2*SKETCH_SUB_BUCKETS));
+    if(sub >= SKETCH_SUB_BUCKETS) sub=SKETCH_SUB_BUCKETS-1;
+    return 1+octave*SKETCH_SUB_BUCKETS+sub;
+}
+
+// Returns the value that stands for a bucket
+double CSketch::getBucketValue(int i) const
+{
+    if(i <= 0) return min;
+    if(i >= SKETCH_NBUCKETS-1) return max;
+    int octave=(i-1)/SKETCH_SUB_BUCKETS;
+    int sub=(i-1)%SKETCH_SUB_BUCKETS;
+    double base=ldexp(1.0,octave+SKETCH_MIN_EXP);
+    return base*(1.0+(sub+0.5)/SKETCH_SUB_BUCKETS);
+}
+
+// Adds a value.  Returns the bytes it allocated.
+size_t CSketch::add(double value)
+{
+    count++;
+    if(value < min) min=value;
+    if(value > max) max=value;
+    return addCount(getBucket(value),1);
+}
+
+// Adds the values of another sketch.  Returns the bytes it allocated.
+size_t CSketch::merge(const CSketch &sketch)
+{
+    size_t grown=0;
+
+    for(int i=0; i < sketch.nBuckets; i++) {
+	grown+=addCount(sketch.buckets[i],sketch.counts[i]);
+    }
+    count+=sketch.count;
+    if(sketch.min < min) min=sketch.min;
+    if(sketch.max > max) max=sketch.max;
+
+    return grown;
+}
+
+// Returns the q quantile, for q from 0 to 1, using the nearest rank.
+// Returns 0 if there are no values.
+double CSketch::getQuantile(double q) const
+{
+    if(!count) return 0.0;
+    unsigned rank=(unsigned)ceil(q*count);
+    if(rank < 1) rank=1;
+    if(rank > count) rank=count;
+
+    unsigned sum=0;
+    int bucket=SKETCH_NBUCKETS-1;
+    for(int i=0; i < nBuckets; i++) {
+	sum+=counts[i];
+	if(sum >= rank) {
+	    bucket=buckets[i];
+	    break;
+	}
+    }
+    double value=getBucketValue(bucket);
+    if(value < min) value=min;
+    if(value > max) value=max;
+    return value;
+}
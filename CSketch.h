@@ -0,0 +1,62 @@
+// Quantile sketch of intervals for ParseCASW
+
+#ifndef _INC_CSKETCH_H
+#define _INC_CSKETCH_H
+
+#include <stddef.h>
+
+// The range of the buckets in powers of 2 seconds, and the number of
+// buckets in each power of 2.  Values below the range, including zero
+// and negative intervals, are in the first bucket, and values above
+// it are in the last.
+#define SKETCH_MIN_EXP (-10)
+#define SKETCH_MAX_EXP 17
+#define SKETCH_SUB_BUCKETS 4
+#define SKETCH_NBUCKETS \
+    ((SKETCH_MAX_EXP-SKETCH_MIN_EXP)*SKETCH_SUB_BUCKETS+2)
+
+// Number of buckets kept in the sketch itself.  A sketch with more
+// keeps them in an array that doubles as needed.
+#define SKETCH_INLINE_BUCKETS 4
+
+// A histogram of values in buckets whose widths grow with the value,
+// so a quantile is found to within about 11% of its value.  Only the
+// buckets that have values are kept, in increasing order, so a group
+// with regular intervals needs only a few and the sketch stays small.
+// Two sketches merge by adding their counts, so sketches from chunks
+// analyzed in parallel give the same result as one sketch.  The
+// minimum and maximum are exact, and quantiles are limited to them.
+// The sketches of groups are in the sketch pool of their CGroupStore.
+class CSketch
+{
+  public:
+    CSketch(void);
+    CSketch(const CSketch &sketch);
+    ~CSketch(void);
+    size_t add(double value);
+    size_t merge(const CSketch &sketch);
+    double getQuantile(double q) const;
+    unsigned getCount(void) const { return count; }
+    size_t getExtraBytes(void) const;
+
+  private:
+    CSketch &operator=(const CSketch &sketch);
+    static int getBucket(double value);
+    double getBucketValue(int i) const;
+    size_t addCount(int bucket, unsigned n);
+    size_t grow(void);
+
+    unsigned count;
+    double min;
+    double max;
+  // The buckets with values and their counts.  They point to the inline
+  // arrays until there are more than SKETCH_INLINE_BUCKETS.
+    int nBuckets;
+    int bucketsSize;
+    unsigned char *buckets;
+    unsigned *counts;
+    unsigned char inlineBuckets[SKETCH_INLINE_BUCKETS];
+    unsigned inlineCounts[SKETCH_INLINE_BUCKETS];
+};
+
+#endif // _INC_CSKETCH_H
@@ -0,0 +1,197 @@
+// Implementation of the store of group summaries for ParseCASW
+
+#include <stdlib.h>
+
+#include <epicsStdio.h>
+
+#include "utils.h"
+#include "CSummaryStore.h"
+
+// Initial size of the array of servers, which doubles as needed
+#define SUMMARY_SERVERS_SIZE 64
+
+// Initial size of the array of summaries of a server, which doubles as
+// needed
+#define SUMMARY_SERVER_SIZE 4
+
+// Nanoseconds per second
+#define SUMMARY_NSEC 1000000000u
+
+// Puts the offset of a time from the base time into seconds and
+// 1/65536 second
+static void putOffset(const epicsTimeStamp &base, const epicsTimeStamp &time,
+  epicsInt32 &sec, epicsUInt16 &frac)
+{
+    epicsInt64 nsec=(epicsInt64)time.nsec-(epicsInt64)base.nsec;
+    sec=(epicsInt32)(time.secPastEpoch-base.secPastEpoch);
+    if(nsec < 0) {
+	nsec+=SUMMARY_NSEC;
+	sec--;
+    }
+    epicsUInt64 scaled=((epicsUInt64)nsec << 16)/SUMMARY_NSEC;
+    frac=(epicsUInt16)scaled;
+}
+
+// Puts the time at an offset from the base time into time
+static void getOffset(const epicsTimeStamp &base, epicsInt32 sec,
+  epicsUInt16 frac, epicsTimeStamp &time)
+{
+    epicsUInt32 nsec=base.nsec+
+      (epicsUInt32)(((epicsUInt64)frac*SUMMARY_NSEC+0x8000u) >> 16);
+    time.secPastEpoch=base.secPastEpoch+(epicsUInt32)sec;
+    if(nsec >= SUMMARY_NSEC) {
+	nsec-=SUMMARY_NSEC;
+	time.secPastEpoch++;
+    }
+    time.nsec=nsec;
+}
+
+// Class CSummaryStore implementations
+
+CSummaryStore::CSummaryStore(void) :
+    servers(NULL),
+    nServers(0),
+    serversSize(0),
+    size(0),
+    capacity(0),
+    starts(NULL)
+{
+}
+
+CSummaryStore::~CSummaryStore(void)
+{
+    for(int i=0; i < nServers; i++) delete [] servers[i].summaries;
+    if(servers) delete [] servers;
+    if(starts) delete [] starts;
+}
+
+// Adds a server with no summaries and returns its slot.  The times of
+// its summaries are kept from its first time.
+int CSummaryStore::addServer(int iocId, const epicsTime &firstTime)
+{
+    if(nServers >= serversSize) {
+	int newSize=serversSize?2*serversSize:SUMMARY_SERVERS_SIZE;
+	ServerSummaries *newServers=new ServerSummaries[newSize];
+	if(!newServers) {
+	    errMsg("Cannot allocate space for summary store");
+	    exit(1);
+	}
+	for(int i=0; i < nServers; i++) newServers[i]=servers[i];
+	if(servers) delete [] servers;
+	servers=newServers;
+	serversSize=newSize;
+    }
+    ServerSummaries &server=servers[nServers];
+    server.baseTime=firstTime;
+    server.iocId=iocId;
+    server.count=0;
+    server.size=0;
+    server.summaries=NULL;
+
+    return nServers++;
+}
+
+// Adds a copy of a summary at the end of the summaries of a server
+void CSummaryStore::add(int slot, const GroupSummary &summary)
+{
+    ServerSummaries &server=servers[slot];
+
+    if(server.count >= server.size) {
+	int newSize=server.size?2*server.size:SUMMARY_SERVER_SIZE;
+	StoredSummary *newSummaries=new StoredSummary[newSize];
+	if(!newSummaries) {
+	    errMsg("Cannot allocate space for summary store");
+	    exit(1);
+	}
+	for(int i=0; i < server.count; i++) {
+	    newSummaries[i]=server.summaries[i];
+	}
+	if(server.summaries) delete [] server.summaries;
+	server.summaries=newSummaries;
+	capacity+=newSize-server.size;
+	server.size=newSize;
+    }
+    StoredSummary &stored=server.summaries[server.count++];
+    putOffset(server.baseTime,summary.firstTime,stored.firstSec,
+      stored.firstFrac);
+    putOffset(server.baseTime,summary.lastTime,stored.lastSec,
+      stored.lastFrac);
+    stored.mean=(float)summary.mean;
+    stored.sigma=(float)summary.sigma;
+    stored.min=(float)summary.min;
+    stored.max=(float)summary.max;
+    stored.p50=(float)summary.p50;
+    stored.p90=(float)summary.p90;
+    stored.p99=(float)summary.p99;
+    stored.nIntervals=summary.nIntervals;
+    stored.increasing=summary.increasing;
+    stored.outOfOrder=summary.outOfOrder;
+    stored.intervalType=summary.intervalType;
+    size++;
+}
+
+// Fills in summary i of a server
+void CSummaryStore::get(int slot, int i, GroupSummary &summary) const
+{
+    const ServerSummaries &server=servers[slot];
+    const StoredSummary &stored=server.summaries[i];
+
+    getOffset(server.baseTime,stored.firstSec,stored.firstFrac,
+      summary.firstTime);
+    getOffset(server.baseTime,stored.lastSec,stored.lastFrac,
+      summary.lastTime);
+    summary.mean=stored.mean;
+    summary.sigma=stored.sigma;
+    summary.min=stored.min;
+    summary.max=stored.max;
+    summary.p50=stored.p50;
+    summary.p90=stored.p90;
+    summary.p99=stored.p99;
+    summary.iocId=server.iocId;
+    summary.nIntervals=stored.nIntervals;
+    summary.increasing=stored.increasing;
+    summary.outOfOrder=stored.outOfOrder;
+    summary.intervalType=stored.intervalType;
+}
+
+// Numbers the summaries of all the servers in the order of their slots
+void CSummaryStore::makeIndex(void)
+{
+    if(starts) delete [] starts;
+    starts=new int[nServers+1];
+    if(!starts) {
+	errMsg("Cannot allocate space for summary index");
+	exit(1);
+    }
+    starts[0]=0;
+    for(int i=0; i < nServers; i++) starts[i+1]=starts[i]+servers[i].count;
+}
+
+// Fills in the summary with a number from makeIndex().  The server is
+// found by a binary search of the starts.
+void CSummaryStore::get(int index, GroupSummary &summary) const
+{
+    int lo=0,hi=nServers-1;
+
+    while(lo < hi) {
+	int mid=(lo+hi+1)/2;
+	if(starts[mid] <= index) lo=mid;
+	else hi=mid-1;
+    }
+    get(lo,index-starts[lo],summary);
+}
+
+// Returns the bytes allocated for the summaries and the servers
+size_t CSummaryStore::getBytes(void) const
+{
+    return (size_t)capacity*sizeof(StoredSummary)+
+      (size_t)serversSize*sizeof(ServerSummaries);
+}
+
+// Formats one line with the usage of the store into buf
+void CSummaryStore::formatStats(char *buf, size_t bufSize) const
+{
+    epicsSnprintf(buf,bufSize,
+      "Summary store: %d summaries of %d servers, %d allocated "
+      "(%.1f KiB)\n",size,nServers,getCapacity(),getBytes()/1024.);
+}
@@ -0,0 +1,101 @@
+// Store of the summaries of compacted groups for ParseCASW
+
+#ifndef _INC_CSUMMARYSTORE_H
+#define _INC_CSUMMARYSTORE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <epicsTypes.h>
+#include <epicsTime.h>
+
+// What is kept of a finished group, which is only what characterize()
+// and the printers need.  It is a fixed size and has no sums, sketch,
+// or links.
+struct GroupSummary
+{
+    epicsTimeStamp firstTime;
+    epicsTimeStamp lastTime;
+    double mean;
+    double sigma;
+    double min;
+    double max;
+    double p50;
+    double p90;
+    double p99;
+    int iocId;
+    int nIntervals;
+    int increasing;
+    int outOfOrder;
+    unsigned char intervalType;
+};
+
+// How a GroupSummary is kept in the store.  The times are offsets from
+// the first time of the server in seconds and 1/65536 second, and the
+// statistics are floats, which is more than the reports print.  The
+// server is the one whose summaries it is with.
+struct StoredSummary
+{
+    epicsInt32 firstSec;
+    epicsInt32 lastSec;
+    epicsUInt16 firstFrac;
+    epicsUInt16 lastFrac;
+    float mean;
+    float sigma;
+    float min;
+    float max;
+    float p50;
+    float p90;
+    float p99;
+    epicsInt32 nIntervals;
+    epicsInt32 increasing;
+    epicsInt32 outOfOrder;
+    unsigned char intervalType;
+};
+
+// The summaries of one server, in time order
+struct ServerSummaries
+{
+    epicsTimeStamp baseTime;
+    int iocId;
+    int count;
+    int size;
+    StoredSummary *summaries;
+};
+
+// The summaries are kept in an array for each server that doubles as
+// needed, so a server needs no links between them.  A server is added
+// with addServer() when its first group is compacted, and its
+// summaries are then found from the slot that returns.  They are
+// never removed, since they are only made in file mode, where they are
+// all reported at the end.  For the report by group, makeIndex()
+// numbers all the summaries from 0 to getSize()-1, which is good
+// until the next add().
+class CSummaryStore
+{
+  public:
+    CSummaryStore(void);
+    ~CSummaryStore(void);
+    int addServer(int iocId, const epicsTime &firstTime);
+    void add(int slot, const GroupSummary &summary);
+    int getCount(int slot) const { return servers[slot].count; }
+    void get(int slot, int i, GroupSummary &summary) const;
+    void makeIndex(void);
+    void get(int index, GroupSummary &summary) const;
+    int getSize(void) const { return size; }
+    unsigned count(void) const { return (unsigned)size; }
+    int getCapacity(void) const { return capacity; }
+    size_t getBytes(void) const;
+    void formatStats(char *buf, size_t bufSize) const;
+
+  private:
+    ServerSummaries *servers;
+    int nServers;
+    int serversSize;
+    int size;
+    int capacity;
+  // The index of the first summary of each server from makeIndex()
+    int *starts;
+};
+
+#endif // _INC_CSUMMARYSTORE_H
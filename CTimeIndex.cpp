@@ -0,0 +1,271 @@
+// Implementation of the sparse index of the times of an input file for
+// ParseCASW
+
+// The binary search only needs to get near the start, since the lines
+// before the start time are dropped as they are read, so it stops when
+// the range is small and does not need to be exact about lines that
+// are out of order.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parsecasw.h"
+#include "utils.h"
+#include "CTimeIndex.h"
+
+// Size of the range at which the binary search stops
+#define SEARCH_MIN_SIZE 65536
+
+// Class CTimeIndex implementations
+
+CTimeIndex::CTimeIndex(void) :
+    errorString(NULL),
+    entries(NULL),
+    nEntries(0),
+    builtEntries(NULL),
+    builtSize(0)
+{
+    memset(&header,0,sizeof(header));
+}
+
+CTimeIndex::~CTimeIndex(void)
+{
+    close();
+}
+
+// Makes the name of the index of an input file.  Returns P_OK or
+// P_ERROR if it is too long.
+int CTimeIndex::makeFileName(const char *inputName, char *indexName,
+  size_t size)
+{
+    if(makeStampedName(inputName,INDEX_SUFFIX,indexName,size)) {
+	return P_ERROR;
+    }
+    return P_OK;
+}
+
+void CTimeIndex::add(epicsInt64 timeKey, epicsUInt64 offset)
+{
+    if(nEntries >= builtSize) {
+	int newSize=builtSize?2*builtSize:1024;
+	IndexEntry *newEntries=new IndexEntry[newSize];
+	if(!newEntries) {
+	    errMsg("Cannot allocate space for index entries");
+	    exit(1);
+	}
+	for(int i=0; i < nEntries; i++) newEntries[i]=builtEntries[i];
+	if(builtEntries) delete [] builtEntries;
+	builtEntries=newEntries;
+	builtSize=newSize;
+    }
+    builtEntries[nEntries].timeKey=timeKey;
+    builtEntries[nEntries].offset=offset;
+    nEntries++;
+    entries=builtEntries;
+}
+
+// Reads all the lines of the mapped file and makes the entries.
+// Returns P_OK.
+int CTimeIndex::build(const CMappedFile &mappedFile, CaswFileType fileType,
+  const CTimeCache &timeCacheIn)
+{
+    CTimeCache timeCache=timeCacheIn;
+    CaswLine caswLine;
+    const char *begin=mappedFile.getBegin();
+    const char *end=mappedFile.getEnd();
+    const char *lineEnd;
+    epicsTime time;
+    epicsInt64 nextKey=0;
+    int first=1;
+
+    close();
+    for(const char *cur=begin; cur < end; cur=lineEnd) {
+	lineEnd=CMappedFile::frameLine(cur,end);
+	if(parseLine(cur,lineEnd,fileType,&caswLine) != P_OK) continue;
+	if(timeCache.getTime(&caswLine,&time) != P_OK) continue;
+	epicsInt64 key=timeToNs(time);
+	if(!first && key < nextKey) continue;
+	if(timeCache.isAmbiguous(&caswLine)) continue;
+	add(key,(epicsUInt64)(cur-begin));
+	nextKey=key+(epicsInt64)INDEX_INTERVAL*1000000000LL;
+	first=0;
+    }
+    header.interval=INDEX_INTERVAL;
+
+    return P_OK;
+}
+
+// Writes the entries that were built.  Returns P_OK or P_ERROR.
+int CTimeIndex::write(const char *indexName, const char *inputName,
+  epicsUInt32 options)
+{
+    errorString=NULL;
+    if(initStampedHeader(header.stamped,INDEX_MAGIC,INDEX_VERSION,
+	 inputName,options)) {
+	errorString="Cannot get the size and time of the input";
+	return P_ERROR;
+    }
+    header.nEntries=(epicsUInt64)nEntries;
+
+    FILE *fp=fopen(indexName,"wb");
+    if(!fp) {
+	errorString="Cannot open file";
+	return P_ERROR;
+    }
+    int ok=fwrite(&header,sizeof(header),1,fp) == 1;
+    if(ok && nEntries > 0) {
+	ok=fwrite(entries,sizeof(IndexEntry),nEntries,fp) ==
+	  (size_t)nEntries;
+    }
+    if(fclose(fp)) ok=0;
+    if(!ok) {
+	errorString="Error writing file";
+	remove(indexName);
+	return P_ERROR;
+    }
+
+    return P_OK;
+}
+
+// Maps the index of an input file and checks that it is up to date.
+// Returns P_OK or P_ERROR.
+int CTimeIndex::open(const char *indexName, const char *inputName,
+  epicsUInt32 options)
+{
+    close();
+    errorString=NULL;
+    if(mappedIndex.open(indexName) != P_OK) {
+	errorString="Cannot map file";
+	return P_ERROR;
+    }
+    if(mappedIndex.getSize() < sizeof(header)) {
+	errorString="Not an index file";
+	close();
+	return P_ERROR;
+    }
+    memcpy(&header,mappedIndex.getBegin(),sizeof(header));
+    errorString=checkStampedHeader(header.stamped,INDEX_MAGIC,
+      INDEX_VERSION,inputName,options);
+    if(errorString) {
+	close();
+	return P_ERROR;
+    }
+    if(sizeof(header)+header.nEntries*sizeof(IndexEntry) !=
+      mappedIndex.getSize()) {
+	errorString="Index file is the wrong size";
+	close();
+	return P_ERROR;
+    }
+
+    entries=(const IndexEntry *)(mappedIndex.getBegin()+sizeof(header));
+    nEntries=(int)header.nEntries;
+    for(int i=0; i < nEntries; i++) {
+	if(entries[i].offset >= header.stamped.inputSize) {
+	    errorString="Index file has bad offsets";
+	    close();
+	    return P_ERROR;
+	}
+    }
+
+    return P_OK;
+}
+
+void CTimeIndex::close(void)
+{
+    mappedIndex.close();
+    if(builtEntries) {
+	delete [] builtEntries;
+	builtEntries=NULL;
+    }
+    builtSize=0;
+    entries=NULL;
+    nEntries=0;
+}
+
+// Returns where to start reading for the lines at or after time, which
+// is the last entry that is before it, or the beginning
+const char *CTimeIndex::findStart(const CMappedFile &mappedFile,
+  const epicsTime &time) const
+{
+    epicsInt64 key=timeToNs(time);
+    int lo=0;
+    int hi=nEntries;
+
+  // Find the first entry that is not before it
+    while(lo < hi) {
+	int mid=lo+(hi-lo)/2;
+	if(entries[mid].timeKey < key) lo=mid+1;
+	else hi=mid;
+    }
+    if(lo == 0) return mappedFile.getBegin();
+    return mappedFile.getBegin()+entries[lo-1].offset;
+}
+
+// Returns where to start reading for the lines at or after time by a
+// binary search of the lines of the mapped file
+const char *CTimeIndex::searchStart(const CMappedFile &mappedFile,
+  CaswFileType fileType, const CTimeCache &timeCacheIn,
+  const epicsTime &time)
+{
+    CTimeCache timeCache=timeCacheIn;
+    CaswLine caswLine;
+    epicsTime lineTime;
+    const char *begin=mappedFile.getBegin();
+    const char *end=mappedFile.getEnd();
+    const char *lo=begin;
+    const char *hi=end;
+
+  // The line at lo is before the time, or lo is the beginning, and the
+  // lines from hi on are not before it
+    while(hi-lo > SEARCH_MIN_SIZE) {
+	const char *mid=lo+(hi-lo)/2;
+	const char *nl=(const char *)memchr(mid,'\n',(size_t)(hi-mid));
+	const char *cur=nl?nl+1:hi;
+	const char *lineEnd;
+	for(; cur < hi; cur=lineEnd) {
+	    lineEnd=CMappedFile::frameLine(cur,end);
+	    if(parseLine(cur,lineEnd,fileType,&caswLine) == P_OK &&
+	      timeCache.getTime(&caswLine,&lineTime) == P_OK) {
+		break;
+	    }
+	}
+	if(cur >= hi) {
+	    hi=mid;
+	} else if(lineTime < time) {
+	    lo=cur;
+	} else {
+	    hi=mid;
+	}
+    }
+
+    return findUnambiguous(lo,begin,end,fileType,timeCache);
+}
+
+// Returns cur if the first valid line from there has a time that is
+// not ambiguous, or else the last line before that does
+const char *CTimeIndex::findUnambiguous(const char *cur, const char *begin,
+  const char *end, CaswFileType fileType, CTimeCache &timeCache)
+{
+    CaswLine caswLine;
+    const char *lineEnd;
+    const char *p;
+
+    for(p=cur; p < end; p=lineEnd) {
+	lineEnd=CMappedFile::frameLine(p,end);
+	if(parseLine(p,lineEnd,fileType,&caswLine) == P_OK) break;
+    }
+    if(p >= end || !timeCache.isAmbiguous(&caswLine)) return cur;
+
+  // Go back a line at a time
+    while(cur > begin) {
+	lineEnd=cur;
+	for(cur=lineEnd-1; cur > begin && cur[-1] != '\n'; cur--) ;
+	if(parseLine(cur,lineEnd,fileType,&caswLine) == P_OK &&
+	  !timeCache.isAmbiguous(&caswLine)) {
+	    break;
+	}
+    }
+
+    return cur;
+}
@@ -0,0 +1,85 @@
+// Sparse index of the times of an input file for ParseCASW
+
+#ifndef _INC_CTIMEINDEX_H
+#define _INC_CTIMEINDEX_H
+
+#include <stddef.h>
+
+#include <epicsTypes.h>
+#include <epicsTime.h>
+
+#include "parseLine.h"
+#include "utils.h"
+#include "CMappedFile.h"
+
+#define INDEX_MAGIC "PCASWIX"
+#define INDEX_VERSION 2
+// Appended to the name of the input file to get the name of the index
+#define INDEX_SUFFIX ".pindex"
+// Seconds of input time between the entries
+#define INDEX_INTERVAL 300
+
+// The header is followed by the entries.  The options are those that
+// affect the times, including the time zone.
+struct IndexHeader
+{
+    StampedHeader stamped;
+    epicsUInt32 interval;
+    epicsUInt64 nEntries;
+};
+
+// The time in nanoseconds since the EPICS epoch of a line and its
+// offset in the file
+struct IndexEntry
+{
+    epicsInt64 timeKey;
+    epicsUInt64 offset;
+};
+
+// Finds where to start reading a file for the lines at or after a
+// time, which relies on the lines being in time order, as CASW writes
+// them.  The index has the first valid line after each INDEX_INTERVAL
+// of input time, so the start is found without reading the file.
+// Without one the lines are found by a binary search of the mapped
+// file.  In both cases the start is at a line whose time is not
+// ambiguous, so the time cache converts the lines from there the same
+// as reading from the beginning does.
+class CTimeIndex
+{
+  public:
+    CTimeIndex(void);
+    ~CTimeIndex(void);
+    static int makeFileName(const char *inputName, char *indexName,
+      size_t size);
+    int build(const CMappedFile &mappedFile, CaswFileType fileType,
+      const CTimeCache &timeCache);
+    int write(const char *indexName, const char *inputName,
+      epicsUInt32 options);
+    int open(const char *indexName, const char *inputName,
+      epicsUInt32 options);
+    void close(void);
+    int isOpen(void) const { return entries != NULL; }
+    int getCount(void) const { return nEntries; }
+    const char *findStart(const CMappedFile &mappedFile,
+      const epicsTime &time) const;
+    static const char *searchStart(const CMappedFile &mappedFile,
+      CaswFileType fileType, const CTimeCache &timeCache,
+      const epicsTime &time);
+    const char *getErrorString(void) const { return errorString; }
+
+  private:
+    static const char *findUnambiguous(const char *cur, const char *begin,
+      const char *end, CaswFileType fileType, CTimeCache &timeCache);
+    void add(epicsInt64 timeKey, epicsUInt64 offset);
+
+    IndexHeader header;
+    const char *errorString;
+    const IndexEntry *entries;
+    int nEntries;
+  // The entries that are built, or else NULL if they are mapped
+    IndexEntry *builtEntries;
+    int builtSize;
+    CMappedFile mappedIndex;
+};
+
+#endif // _INC_CTIMEINDEX_H
@@ -0,0 +1,176 @@
+// Synthetic Channel Access beacon sender for testing parsecasw -beacon
+
+// Sends CA_PROTO_RSRV_IS_UP beacons for a number of simulated servers
+// to EPICS_CA_REPEATER_PORT on a host, by default the loopback
+// address.  Each server has its own address in the beacon, so they can
+// all come from one process.  The servers start up the same way as
+// rsrv, with the interval starting small and doubling up to the
+// period, and one of them can be rebooted at a regular interval to
+// make anomalies.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <osiSock.h>
+#include <envDefs.h>
+#include <caProto.h>
+#include <epicsTime.h>
+#include <epicsThread.h>
+
+// Default number of servers
+#define SIM_SERVERS 10
+// Default beacon period in sec
+#define SIM_PERIOD 1.0
+// First interval in sec after a server starts
+#define SIM_MIN_PERIOD .02
+// First address for the servers, 10.0.0.1
+#define SIM_FIRST_ADDR 0x0a000001u
+// Port the servers use
+#define SIM_SERVER_PORT 5064
+
+struct SimServer
+{
+    epicsTime nextTime;
+    double interval;
+    unsigned beaconNumber;
+};
+
+static void usage(void);
+
+int main(int argc, char **argv)
+{
+    const char *host="127.0.0.1";
+    int nServers=SIM_SERVERS;
+    double period=SIM_PERIOD;
+    double rebootInterval=0.0;
+    double runTime=0.0;
+    osiSockAddr dest;
+    caHdr hdr;
+    char errString[256];
+    unsigned long nSent=0;
+    int nextReboot=0;
+    int i;
+
+    for(i=1; i < argc; i++) {
+	if(!strcmp(argv[i],"-host") && i+1 < argc) {
+	    host=argv[++i];
+	} else if(!strcmp(argv[i],"-servers") && i+1 < argc) {
+	    nServers=atoi(argv[++i]);
+	} else if(!strcmp(argv[i],"-period") && i+1 < argc) {
+	    period=atof(argv[++i]);
+	} else if(!strcmp(argv[i],"-reboot") && i+1 < argc) {
+	    rebootInterval=atof(argv[++i]);
+	} else if(!strcmp(argv[i],"-time") && i+1 < argc) {
+	    runTime=atof(argv[++i]);
+	} else {
+	    usage();
+	    return 1;
+	}
+    }
+    if(nServers <= 0 || period < SIM_MIN_PERIOD) {
+	usage();
+	return 1;
+    }
+
+    if(!osiSockAttach()) {
+	fprintf(stderr,"Cannot attach to the socket library\n");
+	return 1;
+    }
+    SOCKET sock=epicsSocketCreate(AF_INET,SOCK_DGRAM,IPPROTO_UDP);
+    if(sock == INVALID_SOCKET) {
+	epicsSocketConvertErrnoToString(errString,sizeof(errString));
+	fprintf(stderr,"Cannot create socket: %s\n",errString);
+	return 1;
+    }
+    if(aToIPAddr(host,envGetInetPortConfigParam(&EPICS_CA_REPEATER_PORT,
+	 (unsigned short)CA_REPEATER_PORT),&dest.ia) < 0) {
+	fprintf(stderr,"Invalid host: %s\n",host);
+	return 1;
+    }
+
+    SimServer *servers=new SimServer[nServers];
+    if(!servers) {
+	fprintf(stderr,"Cannot allocate space for servers\n");
+	return 1;
+    }
+    epicsTime startTime=epicsTime::getCurrent();
+    for(i=0; i < nServers; i++) {
+	servers[i].nextTime=startTime;
+	servers[i].interval=SIM_MIN_PERIOD;
+	servers[i].beaconNumber=0;
+    }
+    epicsTime rebootTime=startTime+rebootInterval;
+
+    memset(&hdr,0,sizeof(hdr));
+    hdr.m_cmmd=htons(CA_PROTO_RSRV_IS_UP);
+    hdr.m_dataType=htons(CA_MINOR_PROTOCOL_REVISION);
+    hdr.m_count=htons(SIM_SERVER_PORT);
+
+    while(1) {
+	epicsTime now=epicsTime::getCurrent();
+	if(runTime > 0.0 && now-startTime >= runTime) break;
+
+      // Reboot the next server.  It is silent for a few periods and
+      // then starts over.
+	if(rebootInterval > 0.0 && now >= rebootTime) {
+	    SimServer *pServer=&servers[nextReboot];
+	    pServer->nextTime=now+4.0*period;
+	    pServer->interval=SIM_MIN_PERIOD;
+	    pServer->beaconNumber=0;
+	    nextReboot=(nextReboot+1)%nServers;
+	    rebootTime=rebootTime+rebootInterval;
+	}
+
+      // Send the beacons that are due
+	epicsTime nextTime=now+period;
+	for(i=0; i < nServers; i++) {
+	    SimServer *pServer=&servers[i];
+	    if(pServer->nextTime <= now) {
+		hdr.m_cid=htonl(pServer->beaconNumber++);
+		hdr.m_available=htonl(SIM_FIRST_ADDR+(unsigned)i);
+		if(sendto(sock,(char *)&hdr,sizeof(hdr),0,&dest.sa,
+		     sizeof(dest.ia)) < 0) {
+		    epicsSocketConvertErrnoToString(errString,
+		      sizeof(errString));
+		    fprintf(stderr,"Cannot send beacon: %s\n",errString);
+		} else {
+		    nSent++;
+		}
+		pServer->nextTime=pServer->nextTime+pServer->interval;
+		if(pServer->nextTime < now) pServer->nextTime=now;
+		pServer->interval*=2.0;
+		if(pServer->interval > period) pServer->interval=period;
+	    }
+	    if(pServer->nextTime < nextTime) nextTime=pServer->nextTime;
+	}
+	double delay=nextTime-epicsTime::getCurrent();
+	if(delay > 0.0) epicsThreadSleep(delay);
+    }
+
+    printf("Sent %lu beacons from %d servers\n",nSent,nServers);
+    delete [] servers;
+    epicsSocketDestroy(sock);
+    osiSockRelease();
+
+    return 0;
+}
+
+static void usage(void)
+{
+    printf(
+      "\nbeaconsim\n\n"
+      "Usage: beaconsim [Options]\n"
+      "  Sends Channel Access beacons for simulated servers to\n"
+      "  EPICS_CA_REPEATER_PORT for testing parsecasw -beacon.\n"
+      "\n"
+      "  Options:\n"
+      "    -host <addr>     Send to this address (Default is 127.0.0.1)\n"
+      "    -servers <int>   Number of servers (Default is %d)\n"
+      "    -period <sec>    Beacon period (Default is %g sec)\n"
+      "    -reboot <sec>    Reboot the next server at this interval\n"
+      "                     (Default is no reboots)\n"
+      "    -time <sec>      Stop after this time (Default is to run until\n"
+      "                     killed)\n"
+	,SIM_SERVERS,SIM_PERIOD);
+}
@@ -0,0 +1,364 @@
+// Implementation of the CASW line parser
+
+// This replaces sscanf with the formats
+//   CASW: "%s %d-%d-%d %d:%d:%lf"
+//   OAG:  "%s %d/%d/%d %d:%d:%lf"
+// and follows the same matching rules, so the same lines are accepted
+// and the same values result.  The seconds are decoded into integer
+// seconds and nanoseconds without going through a double except for
+// unusual forms (signs, exponents, more than 9 digits), which use
+// strtod and the same arithmetic as before.  Negative seconds, which
+// could not be converted to an epicsTime, are treated as a mismatch.
+// The name and date are the first two columns in both formats, so with
+// FT_AUTO the character after the year decides the format of the line.
+
+//ioclic1:5064                             2004-05-18 12:17:02.418826640
+//iocs3vp:5064  2004/05/12 00:08:08.0134  2004/05/12 00:08:08.0000
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "parsecasw.h"
+#include "parseLine.h"
+
+// Longest seconds field that is passed to strtod
+#define SEC_FIELD_SIZE 64
+
+// White space as defined by isspace in the C locale
+static inline int isSpace(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline int isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static inline const char *skipSpace(const char *p, const char *end)
+{
+    while(p < end && isSpace(*p)) p++;
+    return p;
+}
+
+// Same as %d.  Returns a pointer past the digits or NULL.
+static inline const char *parseInt(const char *p, const char *end,
+  int *pVal)
+{
+    unsigned val=0;
+    int neg=0;
+
+    p=skipSpace(p,end);
+    if(p < end && (*p == '-' || *p == '+')) {
+	neg=(*p == '-');
+	p++;
+    }
+    if(p >= end || !isDigit(*p)) return NULL;
+    while(p < end && isDigit(*p)) {
+	val=10*val+(unsigned)(*p-'0');
+	p++;
+    }
+    *pVal=neg?-(int)val:(int)val;
+    return p;
+}
+
+// Same as an ordinary character in the format
+static inline const char *parseChar(const char *p, const char *end,
+  char c)
+{
+    if(p >= end || *p != c) return NULL;
+    return p+1;
+}
+
+// Same as %lf followed by the conversion to seconds and nanoseconds
+// that was previously done on the double
+static const char *parseSlowSeconds(const char *p, const char *end,
+  int *pSec, long *pNSec)
+{
+    char field[SEC_FIELD_SIZE];
+    size_t len=end-p;
+    char *fieldEnd;
+
+    if(len >= SEC_FIELD_SIZE) len=SEC_FIELD_SIZE-1;
+    memcpy(field,p,len);
+    field[len]='\0';
+    double dsec=strtod(field,&fieldEnd);
+    if(fieldEnd == field) return NULL;
+    int sec=(int)dsec;
+    double fsec=dsec-(double)sec;
+    *pSec=sec;
+    *pNSec=(int)(1000000000.0*fsec+.5);
+  // Negative nanoseconds cannot be converted to an epicsTime
+    if(*pNSec < 0) return NULL;
+    return p+(fieldEnd-field);
+}
+
+static inline const char *parseSeconds(const char *p, const char *end,
+  int *pSec, long *pNSec)
+{
+    const char *start;
+    unsigned sec=0;
+    unsigned long frac=0;
+    int nInt=0,nFrac=0;
+
+    p=skipSpace(p,end);
+    start=p;
+    while(p < end && isDigit(*p)) {
+	sec=10*sec+(unsigned)(*p-'0');
+	nInt++;
+	p++;
+    }
+    if(p < end && *p == '.') {
+	p++;
+	while(p < end && isDigit(*p)) {
+	    if(nFrac < 9) frac=10*frac+(unsigned long)(*p-'0');
+	    nFrac++;
+	    p++;
+	}
+    }
+
+  // Use strtod for anything other than plain digits
+    if(nInt+nFrac == 0 || nInt > 9 || nFrac > 9 ||
+      (p < end && (*p == 'e' || *p == 'E' || *p == 'x' || *p == 'X'))) {
+	return parseSlowSeconds(start,end,pSec,pNSec);
+    }
+
+    for(int i=nFrac; i < 9; i++) frac*=10;
+    *pSec=(int)sec;
+    *pNSec=(long)frac;
+    return p;
+}
+
+// Parses one line into pLine and sets the format of the line.  Returns
+// P_OK if all the fields were found, otherwise P_ERROR.
+int parseLine(const char *start, const char *end, CaswFileType fileType,
+  CaswLine *pLine)
+{
+    const char *p;
+    char dateDelimiter;
+
+  // Name
+    p=skipSpace(start,end);
+    pLine->name=p;
+    while(p < end && !isSpace(*p)) p++;
+    pLine->nameLen=p-pLine->name;
+    if(!pLine->nameLen) return P_ERROR;
+
+  // Date
+    if(!(p=parseInt(p,end,&pLine->year))) return P_ERROR;
+    if(fileType == FT_AUTO) {
+	if(p >= end) return P_ERROR;
+	if(*p == '-') fileType=FT_CASW;
+	else if(*p == '/') fileType=FT_OAG;
+	else return P_ERROR;
+    }
+    pLine->fileType=fileType;
+    dateDelimiter=(fileType == FT_CASW)?'-':'/';
+    if(!(p=parseChar(p,end,dateDelimiter))) return P_ERROR;
+    if(!(p=parseInt(p,end,&pLine->month))) return P_ERROR;
+    if(!(p=parseChar(p,end,dateDelimiter))) return P_ERROR;
+    if(!(p=parseInt(p,end,&pLine->day))) return P_ERROR;
+
+  // Time
+    if(!(p=parseInt(p,end,&pLine->hour))) return P_ERROR;
+    if(!(p=parseChar(p,end,':'))) return P_ERROR;
+    if(!(p=parseInt(p,end,&pLine->min))) return P_ERROR;
+    if(!(p=parseChar(p,end,':'))) return P_ERROR;
+    if(!(p=parseSeconds(p,end,&pLine->sec,&pLine->nSec))) return P_ERROR;
+
+    return P_OK;
+}
+
+// Class CTimeCache implementations
+
+// A local time that occurs twice when DST ends is resolved with the
+// DST state of the previous line, and a local time that does not exist
+// when DST starts is taken as standard time.  This is what mktime does
+// with tm_isdst=-1 when the lines are converted in order, but it does
+// not depend on the hidden state in mktime, so it is the same when
+// chunks are converted in parallel.  The cache is only used for hours
+// with neither, so it gives the same results.
+
+// Fills in a struct tm from a parsed line
+static void lineToTm(const CaswLine *pLine, struct tm *pTm)
+{
+    memset(pTm,0,sizeof(struct tm));
+    pTm->tm_sec=pLine->sec;
+    pTm->tm_min=pLine->min;
+    pTm->tm_hour=pLine->hour;
+    pTm->tm_mday=pLine->day;
+    pTm->tm_mon=pLine->month-1;
+    pTm->tm_year=pLine->year-1900;
+  // Say we don't know about DST
+    pTm->tm_isdst=-1;
+}
+
+// Returns 1 if the local time is valid with the given DST state and
+// sets the time
+static int isValidTm(struct tm *pTm, int isDst, time_t *pTime)
+{
+    struct tm tmCheck;
+
+    pTm->tm_isdst=isDst;
+    time_t t=mktime(pTm);
+    if(t == (time_t)-1) return 0;
+    if(epicsTime_localtime(&t,&tmCheck) != epicsTimeOK) return 0;
+    *pTime=t;
+    return (tmCheck.tm_isdst > 0) == isDst;
+}
+
+// Returns the conversion of the local time, or -1 if it occurs twice or
+// does not exist.  Sets the DST state.
+static time_t convertUnique(const CaswLine *pLine, int *pIsDst)
+{
+    struct tm tmTime;
+    time_t tStd=0,tDst=0;
+
+    lineToTm(pLine,&tmTime);
+    int validStd=isValidTm(&tmTime,0,&tStd);
+    lineToTm(pLine,&tmTime);
+    int validDst=isValidTm(&tmTime,1,&tDst);
+    if(validStd == validDst) return (time_t)-1;
+    *pIsDst=validDst;
+    return validDst?tDst:tStd;
+}
+
+// Days from 1970-01-01 to the given date in the proleptic Gregorian
+// calendar.  The month may be out of range.  Uses only integers.
+static long daysFromCivil(long year, long month, long day)
+{
+    long m0=month-1;
+    year+=(m0 >= 0)?m0/12:-((11-m0)/12);
+    month=m0-12*((m0 >= 0)?m0/12:-((11-m0)/12))+1;
+    year-=(month <= 2);
+    long era=(year >= 0?year:year-399)/400;
+    long yoe=year-era*400;
+    long doy=(153*(month+(month > 2?-3:9))+2)/5+day-1;
+    long doe=yoe*365+yoe/4-yoe/100+doy;
+    return era*146097+doe-719468;
+}
+
+CTimeCache::CTimeCache(void) :
+    utc(0),
+    isDst(1),
+    valid(0),
+    year(0),
+    month(0),
+    day(0),
+    hour(0),
+    linear(0),
+    hourStart(0),
+    hourIsDst(0)
+{
+}
+
+// Converts a local time that is not in the cache.  Returns -1 if
+// mktime fails.
+time_t CTimeCache::convertLocal(const CaswLine *pLine)
+{
+    struct tm tmTime,tmAlt;
+    time_t tAlt;
+
+    lineToTm(pLine,&tmTime);
+    tmAlt=tmTime;
+    time_t t=mktime(&tmTime);
+    if(t == (time_t)-1) return t;
+    int lineIsDst=(tmTime.tm_isdst > 0);
+
+  // Only when the state changes check if the local time also exists
+  // with the previous state
+    if(lineIsDst != isDst && isValidTm(&tmAlt,isDst,&tAlt)) {
+	t=tAlt;
+	lineIsDst=isDst;
+    }
+    isDst=lineIsDst;
+
+    return t;
+}
+
+// Converts a UTC time with integer arithmetic.  The fields are
+// normalized the same as timegm.
+time_t CTimeCache::convertUtc(const CaswLine *pLine)
+{
+    long days=daysFromCivil(pLine->year,pLine->month,pLine->day);
+
+    return (time_t)(86400L*days+3600L*pLine->hour+60L*pLine->min+
+      pLine->sec);
+}
+
+// Puts the hour of the line in the cache
+void CTimeCache::fill(const CaswLine *pLine)
+{
+    CaswLine lineEnd=*pLine;
+    time_t tStart,tEnd;
+    int isDstStart=0,isDstEnd=0;
+
+    year=pLine->year;
+    month=pLine->month;
+    day=pLine->day;
+    hour=pLine->hour;
+    valid=1;
+
+  // Check the first and last second of the hour
+    lineEnd.min=0;
+    lineEnd.sec=0;
+    tStart=convertUnique(&lineEnd,&isDstStart);
+    lineEnd.min=59;
+    lineEnd.sec=59;
+    tEnd=convertUnique(&lineEnd,&isDstEnd);
+    linear=(tStart != (time_t)-1 && tEnd != (time_t)-1 &&
+      isDstStart == isDstEnd && tEnd-tStart == 3599);
+    hourStart=tStart;
+    hourIsDst=isDstStart;
+}
+
+// Converts the date and time of a parsed line to an epicsTime.  The
+// line time is local time unless setUtc has been called.  Returns P_OK,
+// or P_ERROR if the local time cannot be converted.
+int CTimeCache::getTime(const CaswLine *pLine, epicsTime *pTime)
+{
+    epicsTimeStamp stamp;
+    time_t t;
+
+    if(utc) {
+	t=convertUtc(pLine);
+    } else if(pLine->min >= 0 && pLine->min < 60 &&
+      pLine->sec >= 0 && pLine->sec < 60) {
+	if(!valid || pLine->hour != hour || pLine->day != day ||
+	  pLine->month != month || pLine->year != year) {
+	    fill(pLine);
+	}
+	if(linear) {
+	    t=hourStart+60*pLine->min+pLine->sec;
+	    isDst=hourIsDst;
+	} else {
+	    t=convertLocal(pLine);
+	}
+    } else {
+	t=convertLocal(pLine);
+    }
+    if(t == (time_t)-1) return P_ERROR;
+
+  // Add the nanoseconds, carrying any rounding up to one second
+    unsigned long nSec=(unsigned long)pLine->nSec;
+    stamp.secPastEpoch=(epicsUInt32)(t-POSIX_TIME_AT_EPICS_EPOCH)+
+      (epicsUInt32)(nSec/1000000000ul);
+    stamp.nsec=(epicsUInt32)(nSec%1000000000ul);
+    *pTime=stamp;
+
+    return P_OK;
+}
+
+// Returns 1 if the local time of the line occurs twice, when DST ends,
+// in which case its conversion depends on the previous line
+int CTimeCache::isAmbiguous(const CaswLine *pLine)
+{
+    struct tm tmTime;
+    time_t t;
+
+    if(utc) return 0;
+    lineToTm(pLine,&tmTime);
+    if(!isValidTm(&tmTime,0,&t)) return 0;
+    lineToTm(pLine,&tmTime);
+    return isValidTm(&tmTime,1,&t);
+}
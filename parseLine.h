@@ -0,0 +1,74 @@
+// Include file for the CASW line parser
+
+#ifndef _INC_PARSELINE_H
+#define _INC_PARSELINE_H
+
+#include <stddef.h>
+#include <epicsTime.h>
+
+// The formats of the lines.  With FT_AUTO the format of each line is
+// found from its date delimiter.
+typedef enum _CaswFileType
+{
+    FT_CASW,
+    FT_OAG,
+    FT_AUTO
+} CaswFileType;
+
+// Number of line formats, which index the counts of lines by format
+#define FT_NFORMATS 2
+
+// The fields of one input line.  The name points into the line and
+// is not NUL terminated.
+typedef struct _CaswLine
+{
+    const char *name;
+    size_t nameLen;
+    int year;
+    int month;
+    int day;
+    int hour;
+    int min;
+    int sec;
+    long nSec;
+    CaswFileType fileType;
+} CaswLine;
+
+// Converts the times of parsed lines to epicsTime.  The conversion of
+// the start of the hour is kept, so lines in the same hour as the
+// previous one only need integer adds.  Use one for each thread.  A
+// local time that mktime cannot convert gives P_ERROR.
+class CTimeCache
+{
+  public:
+    CTimeCache(void);
+    void setUtc(int utcIn) { utc=utcIn; valid=0; }
+    int getUtc(void) const { return utc; }
+    int getTime(const CaswLine *pLine, epicsTime *pTime);
+    int isAmbiguous(const CaswLine *pLine);
+
+  private:
+    void fill(const CaswLine *pLine);
+    time_t convertLocal(const CaswLine *pLine);
+    time_t convertUtc(const CaswLine *pLine);
+    int utc;
+    int isDst;
+  // The hour in the cache
+    int valid;
+    int year;
+    int month;
+    int day;
+    int hour;
+  // Whether the hour has one offset from UTC and no repeated times,
+  // and if so its start and DST state
+    int linear;
+    time_t hourStart;
+    int hourIsDst;
+};
+
+// Function prototypes
+
+int parseLine(const char *start, const char *end, CaswFileType fileType,
+  CaswLine *pLine);
+
+#endif // _INC_PARSELINE_H
@@ -13,6 +13,11 @@
 // Time interval in sec for a new group to be declared
 #define NEW_GROUP_TIME 60.0
 
+// Time in sec before -from that is searched for, and after -to that
+// is read before the rest is skipped, so lines a little out of order
+// are not missed
+#define RANGE_SLACK 60.0
+
 // Timer interval in sec
 #define TIMER_INTERVAL 60u
 
@@ -33,9 +38,32 @@
 // Maximum non-increasing intervals for probable IOC coming up
 #define MAX_NONINCREASING_INTERVALS 2
 
+#include <math.h>
+
+#ifndef WIN32
+# include <glob.h>
+#endif
+
 #include "parsecasw.h"
 #include "utils.h"
+#include "parseLine.h"
+#include "CMappedFile.h"
+#include "CCompressedFile.h"
+#include "CLineReader.h"
+#include "CFileSource.h"
+#include "CBeaconListener.h"
+#include "CNameTable.h"
+#include "CGroupStore.h"
 #include "CIoc.h"
+#include "CChunk.h"
+#include "CShard.h"
+#include "COutputThread.h"
+#include "COutput.h"
+#include "CRecordWriter.h"
+#include "CExportFile.h"
+#include "CEventCache.h"
+#include "CTimeIndex.h"
+#include "CNameFilter.h"
 
 // Include array with extra help lines
 #include "help.txt"
@@ -73,51 +101,157 @@ const char *chnString[CHN_ORDER+1]={
     "Anomalies out of order"
 };
 
-typedef enum _CaswFileType
-{
-    FT_CASW,
-    FT_OAG
-} CaswFileType;
+// Names of the characterizations in the records.  Make these
+// consistent with Characterization, too.
+const char *chnKey[CHN_ORDER+1]={
+    "single",
+    "server",
+    "probable_server",
+    "regular",
+    "short",
+    "medium",
+    "long",
+    "very_long",
+    "out_of_order"
+};
+
+// Names of the interval types in the records
+const char *intervalTypeKey[]={
+    "none",
+    "increasing_decreasing",
+    "monotonic_increasing",
+    "monotonic_decreasing"
+};
+
+// Columns of the records for a group and for a server
+static const char *const groupColumns[]={
+    "server","first_ns","last_ns","events","out_of_order",
+    "characterization","interval_type","increasing",
+    "mean_ns","sigma_ns","min_ns","max_ns","p50_ns","p90_ns","p99_ns"
+};
+static const char *const iocColumns[]={
+    "server","first_ns","last_ns","groups","intervals",
+    "p50_ns","p90_ns","p99_ns"
+};
+#define N_GROUP_COLUMNS (int)(sizeof(groupColumns)/sizeof(char *))
+#define N_IOC_COLUMNS (int)(sizeof(iocColumns)/sizeof(char *))
 
 // Function prototypes
 int main(int argc, char **argv);
 static int parseCommand(int argc, char **argv);
+static int addFileNames(const char *pattern);
+static int addFileName(const char *name);
+static void processLine(const char *start, const char *end, int lineNum);
+static void processEvent(const char *name, size_t nameLen, unsigned hash,
+  epicsTime time, int lineNum);
+static void dispatchEvent(int id, epicsTime time, int lineNum);
+static void processChunks(CMappedFile &mappedFile);
+static void openCache(void);
+static int processCache(void);
+static void processRange(CMappedFile &mappedFile);
+static const char *findRangeStart(CMappedFile &mappedFile);
+static int parseTimeOption(const char *string, CaswLine *pLine);
+static int convertRange(void);
+static int processFiles(void);
+static int processBeacons(CBeaconListener &beaconListener);
 static void usage(void);
 static void report(SortMode sortMode);
+static CSnapshot *takeSnapshot(void);
+static void printSnapshot(const CSnapshot &snapshot);
+static void printDrops(void);
 static void sortByIoc(void);
 static void reportByIoc();
-static void printIoc(CIoc *pIoc);
+static void printIoc(CShard &shard, CIoc *pIoc);
+static int printIocHeader(const char *name, const IocSummary &summary);
+static void printIocGroup(int groupNum, const GroupSummary &summary);
+static void printEventCount(int nPoints, int outOfOrder);
+static void printTimeSpan(const epicsTime &firstTime,
+  const epicsTime &lastTime);
+static void printDuration(double delTime);
+static void printStatistics(const GroupSummary &summary);
 static void sortByGroup(SortMode sortMode);
 static void reportByGroup();
-static void printGroup(CGroup *pGroup);
-static Characterization characterize(CGroup *pGroup);
+static void printGroup(const char *name, const GroupSummary &summary);
+static Characterization characterize(const GroupSummary &summary);
 void removeFinished(void);
+static void pauseShards(void);
+static void resumeShards(void);
+static void printQuantiles(const char *indent, double p50, double p90,
+  double p99);
+static void printPoolStats(const CSnapshot *pSnapshot=NULL);
+static void writeGroupRecord(const char *name, const GroupSummary &summary);
+static void writeIocRecord(const char *name, const IocSummary &summary);
+static void putNanoseconds(double sec);
+static int exportGroups(void);
+static int reportImport(void);
 
 // Global variables
 
-//ioclic1:5064                             2004-05-18 12:17:02.418826640
-const char caswFormat[]="%s %d-%d-%d %d:%d:%lf";
-//                       iocs3vp:5064  2004/05/12 00:08:08.0134  2004/05/12 00:08:08.0000 
-const char oagFormat[]="%s %d/%d/%d %d:%d:%lf";
-
-epicsMutexId lock=NULL;
-resTable<CIoc,stringId> iocTable;
+CNameTable iocNames;
+CShard **shards=NULL;
+int nShards=1;
+COutputThread *pOutputThread=NULL;
+int nHolds=0;
+double holdTotal=0.0;
+double holdMax=0.0;
 CIoc **iocs=NULL;
-CGroup **groups=NULL;
-double *timeDiffs=NULL;
+// Group ids, or ~index for the summaries
+int *groups=NULL;
+// The shard of each of the iocs or groups
+int *shardIds=NULL;
+long long *timeKeys=NULL;
+int *timeTies=NULL;
 int *indices=NULL;
 int nArray;
 SortMode defaultSortMode=SORT_GROUP;
 int verbose=0;
 int terse=0;
 int realTime=0;
+// Drop events instead of waiting when the analysis falls behind
+int liveMode=0;
 int echo=0;
 int doUsage=0;
-CaswFileType fileType=FT_CASW;
+CaswFileType fileType=FT_AUTO;
 int caswFileSpecified=0;
 char caswFileName[PATH_MAX];
+char **caswFileNames=NULL;
+int nCaswFiles=0;
+int caswFileNamesSize=0;
 int linesSkipped=0;
+// Lines or anomalies whose servers are not accepted by the filter
+int linesFiltered=0;
+int lineCounts[FT_NFORMATS];
 unsigned timerInterval=TIMER_INTERVAL;
+int nJobs=1;
+int utc=0;
+int expectedServers=0;
+int beaconMode=0;
+int exportFileSpecified=0;
+char exportFileName[PATH_MAX];
+int importFileSpecified=0;
+char importFileName[PATH_MAX];
+int useCache=0;
+char cacheFileName[PATH_MAX];
+CEventCache eventCache;
+int fromSpecified=0;
+int toSpecified=0;
+CaswLine fromLine;
+CaswLine toLine;
+epicsTime fromTime;
+epicsTime toTime;
+epicsTime stopTime;
+// Set when the lines are past the end of the time range
+int pastRange=0;
+int useIndex=0;
+CNameFilter nameFilter;
+size_t maxMem=0;
+CTimeCache timeCache;
+COutput output;
+CRecordWriter records(output);
+// Where the echo and the counts and statistics are printed.  It is
+// stderr for the record formats, as are the errors, so stdout only has
+// records.
+FILE *infoFile=stdout;
 
 // CParseTimer implementation
 
@@ -131,18 +265,32 @@ CParseTimer::expire(const epicsTime &curTime)
 	return epicsTimerNotify::expireStatus(restart,interval);
     }
 
-    epicsMutexLock(lock);
+  // Stop the shard workers between events only while the finished
+  // groups are taken and removed.  The time they are stopped is the
+  // time the input can back up in the rings.
+    epicsTime startTime=epicsTime::getCurrent();
+    pauseShards();
 #if DEBUG_REALTIME && 0
     printf("Starting report\n");
 #endif
-    report(SORT_FINISHED);
+    CSnapshot *pSnapshot=takeSnapshot();
+    resumeShards();
+    double holdTime=epicsTime::getCurrent()-startTime;
 #if DEBUG_REALTIME
-    if(nArray) {
-	printf("Ending report: %d items\n",nArray);
+    if(pSnapshot) {
+	printf("Ending report: %d items\n",pSnapshot->getCount());
 	fflush(stdout);
     }
 #endif
-    epicsMutexUnlock(lock);
+    nHolds++;
+    holdTotal+=holdTime;
+    if(holdTime > holdMax) holdMax=holdTime;
+
+  // Print them on the output thread
+    if(pSnapshot) {
+	pSnapshot->setHoldTime(holdTime);
+	pOutputThread->queue(pSnapshot);
+    }
 
   // Set to continue
     return epicsTimerNotify::expireStatus(restart,interval);
@@ -153,18 +301,12 @@ int main(int argc, char **argv)
 {
     epicsTimerQueueActive *timerQueue=NULL;
     CParseTimer *parseTimer=NULL;
-    FILE *caswFp=NULL;
+    CMappedFile mappedFile;
+    CLineReader lineReader;
+    CBeaconListener beaconListener;
     int retVal=0;
-    char *bytes;
     int lineNum=0;
-    char line[READ_LINESIZE];
-    char name[READ_LINESIZE];
-    int year=0,month=0,day=0,hour=0,min=0,sec=0;
-    double dsec=0.0,fsec=0.0;
-    local_tm_nano_sec tmnanotime;
-    epicsTime time;
-    int items=0;
-    CIoc *pIoc;
+    const char *start,*end;
 
   // Parse the command line
     int status=parseCommand(argc,argv);
@@ -174,18 +316,125 @@ int main(int argc, char **argv)
     }
     if(status != P_OK) exit(1);
 
-    if(!caswFileSpecified) realTime=1;
+    if(beaconMode && caswFileSpecified) {
+	errMsg("\nA file cannot be used with -beacon");
+	usage();
+	exit(1);
+    }
+    if(importFileSpecified && (beaconMode || caswFileSpecified)) {
+	errMsg("\nA file or -beacon cannot be used with -import");
+	usage();
+	exit(1);
+    }
+    if(exportFileSpecified && (importFileSpecified || !caswFileSpecified)) {
+	errMsg("\n-export needs a file to read");
+	usage();
+	exit(1);
+    }
+    if(useCache && (nCaswFiles != 1 || beaconMode)) {
+	errMsg("\n-cache needs a single file to read");
+	usage();
+	exit(1);
+    }
+    if((fromSpecified || toSpecified) &&
+      (importFileSpecified || !caswFileSpecified)) {
+	errMsg("\n-from and -to need a file to read");
+	usage();
+	exit(1);
+    }
+    if(useIndex && nCaswFiles != 1) {
+	errMsg("\n-index needs a single file to read");
+	usage();
+	exit(1);
+    }
+    if(!caswFileSpecified && !importFileSpecified) realTime=1;
+    if(liveMode && !realTime) {
+	errMsg("\n-live needs stdin or -beacon");
+	usage();
+	exit(1);
+    }
+
+  // Keep stdout for the records
+    if(records.getFormat() != RF_TEXT) {
+	infoFile=stderr;
+	setErrFile(stderr);
+    }
+
+  // Size the server table
+    if(expectedServers > 0) iocNames.reserve(expectedServers);
+
+  // Use UTC for the input times and for printing them
+    if(utc) {
+	static char tzString[]="TZ=UTC";
+#ifdef WIN32
+	_putenv(tzString);
+	_tzset();
+#else
+	putenv(tzString);
+	tzset();
+#endif
+	timeCache.setUtc(1);
+    }
+    if(convertRange() != P_OK) {
+	usage();
+	exit(1);
+    }
 
   // Setup real time
     if(realTime) {
       // Do overrides
 	defaultSortMode=SORT_GROUP;
 	caswFileSpecified=0;
+      // Finished groups are reported and removed
+	maxMem=0;
+    }
+
+  // Start the writer of the reports to stdout
+    if(output.open(fileno(stdout)) != P_OK) {
+	errMsg("Cannot start output thread");
+	goto ERROR;
+    }
 
-      // Make a mutex
-	lock=epicsMutexCreate();
-	if(!lock) {
-	    errMsg("Cannot create mutex");
+  // Print the report from an export file instead of analyzing input
+    if(importFileSpecified) {
+	if(reportImport() != P_OK) goto ERROR;
+	goto FINISH;
+    }
+
+  // Make the shards.  The budget is divided among them.
+    shards=new CShard *[nShards];
+    if(!shards) {
+	errMsg("Cannot allocate space for shards array");
+	exit(1);
+    }
+    for(int i=0; i < nShards; i++) {
+	shards[i]=new CShard(NEW_GROUP_TIME,maxMem/nShards);
+	if(!shards[i]) {
+	    errMsg("Cannot allocate space for shard");
+	    exit(1);
+	}
+      // The timer only looks at the groups that have expired
+	if(realTime) shards[i]->getGroupStore().trackDeadlines();
+    }
+
+  // Start the shard workers, which own the servers and groups until the
+  // end of the input.  This thread reads the lines and passes the
+  // events to them through their rings.  With one shard and a file the
+  // events are added on this thread.
+    if(realTime || nShards > 1) {
+	for(int i=0; i < nShards; i++) {
+	    if(shards[i]->start() != P_OK) {
+		errMsg("Cannot start shard thread");
+		goto ERROR;
+	    }
+	}
+    }
+
+    if(realTime) {
+      // Start the output thread, which prints what the timer takes
+	pOutputThread=new COutputThread(printSnapshot);
+	if(!pOutputThread || pOutputThread->start() != P_OK) {
+	    errMsg("Cannot start output thread");
 	    goto ERROR;
 	}
 
@@ -206,124 +455,119 @@ int main(int argc, char **argv)
 	}
     }
 
-  // Open the file
-    if(caswFileSpecified) {
-	caswFp=fopen(caswFileName,"r");
-	if(!caswFp) {
-	    errMsg("Cannot read file:\n%s",caswFileName);
-	    goto ERROR;
+  // Open the input.  Map the file if it is to be analyzed in parallel
+  // chunks, otherwise read it or stdin with the line reader, which also
+  // decompresses it.
+    if(beaconMode) {
+	if(beaconListener.open() != P_OK) goto ERROR;
+    } else if(nCaswFiles > 1) {
+      // The files are opened by processFiles
+    } else if(caswFileSpecified) {
+      // Use the cache of the events if it is up to date.  Otherwise it
+      // is made from the lines, which are then read in order.
+	if(useCache) openCache();
+	if(!eventCache.isReading()) {
+	    if((fromSpecified || toSpecified || useIndex ||
+		 (nJobs > 1 && nShards == 1 && !echo && !maxMem)) &&
+	      !eventCache.isWriting() &&
+	      CCompressedFile::detect(caswFileName) == CT_NONE) {
+		mappedFile.open(caswFileName);
+	    }
+	    if(useIndex && !mappedFile.isOpen()) {
+		fprintf(infoFile,"Cannot index %s: It is not a plain file\n",
+		  caswFileName);
+	    }
+	    if(!mappedFile.isOpen() && lineReader.open(caswFileName) != P_OK) {
+		errMsg("Cannot read file:\n%s\n%s",caswFileName,
+		  lineReader.getErrorString());
+		goto ERROR;
+	    }
 	}
     } else {
-	caswFp=stdin;
+	lineReader.openStdin();
     }
 
   // Read the lines
-    while(1) {
-	bytes=fgets(line,READ_LINESIZE,caswFp);
-	lineNum++;
-	if(!bytes) break;
-	if(ferror(caswFp)) {
-	    errMsg("Error reading line %d of %s",lineNum,caswFileName);
-	    goto ERROR;
-	}
-	if(fileType == FT_CASW) {
-	    items=sscanf(line,caswFormat, name,
-	      &year,&month,&day,&hour,&min,&dsec);
-	} else {
-	    items=sscanf(line,oagFormat, name,
-	      &year,&month,&day,&hour,&min,&dsec);
+    if(beaconMode) {
+      // Use the beacon anomalies instead of lines
+	if(processBeacons(beaconListener) != P_OK) goto ERROR;
+    } else if(nCaswFiles > 1) {
+      // Parse each file on its own thread and merge them
+	if(processFiles() != P_OK) goto ERROR;
+    } else if(eventCache.isReading()) {
+      // Use the events from the cache instead of the lines
+	if(processCache() != P_OK) goto ERROR;
+    } else if(mappedFile.isOpen() &&
+      (fromSpecified || toSpecified || useIndex)) {
+      // Read the lines in the time range of the mapped file
+	if(mappedFile.getSize() > 0) processRange(mappedFile);
+    } else if(mappedFile.isOpen()) {
+      // Analyze chunks of the mapped file in parallel
+	if(mappedFile.getSize() > 0) processChunks(mappedFile);
+    } else {
+	while(lineReader.getLine(&start,&end)) {
+	    lineNum++;
+	    processLine(start,end,lineNum);
+	    if(pastRange) break;
+#if DEBUG_LIMIT
+	    if(lineNum >= LINE_LIMIT) break;
+#endif
 	}
-
-      // Only use lines that have all expected items
-	if(items != 7) {
-	    linesSkipped++;
-	    continue;
+	if(lineReader.getStatus() != P_OK) {
+	    errMsg("Error reading %s after line %d:\n%s",
+	      caswFileSpecified?caswFileName:"stdin",lineNum,
+	      lineReader.getErrorString());
+	    goto ERROR;
 	}
+    }
 
-      // Put the information in a local_tm_nano_sec, which contains a
-      // struct tm
-	sec=(int)dsec;
-	fsec=dsec-(double)sec;
-	memset(&tmnanotime,0,sizeof(tmnanotime));
-	tmnanotime.ansi_tm.tm_sec=sec;
-	tmnanotime.ansi_tm.tm_min=min;
-	tmnanotime.ansi_tm.tm_hour=hour;
-	tmnanotime.ansi_tm.tm_mday=day;
-	tmnanotime.ansi_tm.tm_mon=month-1;
-	tmnanotime.ansi_tm.tm_year=year-1900;
-      // Say we don't know about DST
-	tmnanotime.ansi_tm.tm_isdst=-1;
-      // Define the nanosec part
-	tmnanotime.nSec=(int)(1000000000.0*fsec+.5);
-      // Convert it to a epicsTime
-	time=tmnanotime;
-
-#if DEBUG_PARSE
-	printf(line);
-	printf("name=%s\n"
-	  "year=%d month=%d day=%d hour=%d min=%d dsec=%.5f sec=%d fsec=%.5f\n",
-	  name,
-	  year,month,day,hour,min,dsec,sec,fsec);
-	static char timeStampStr[512];
-	time.strftime(timeStampStr,20,"%b %d %H:%M:%S");
-	
-	printf("%s\n",timeStampStr);
-#endif
-
-      // Echo the input lines
-	if(echo) printf("%s",line);
-
-      // Lock
-	if(realTime) epicsMutexLock(lock);
-
-      // See if we have it
-	stringId *id=new stringId(name);
-	if(!id) {
-	    errMsg("Failed to create ID for line %d: %s",
-	      lineNum,name);
-	    exit(1);
-	}
-	pIoc=iocTable.lookup(*id);
-	delete id;
-	id=NULL;
-	if(pIoc) {
-	  // We have it already
-#if DEBUG_PARSE
-	    printf("IOC Found: %s\n",pIoc->resourceName());
-#endif
-	    pIoc->update(time,NEW_GROUP_TIME);
-	} else {
-	  // Create a new one
-#if DEBUG_PARSE
-	    printf("New IOC\n");
-#endif
-#if DEBUG_REALTIME
-	    printf(" Creating ioc: %s\n",name);
-#endif
-	    pIoc=new CIoc(name,time);
-	    if(!pIoc) {
-		errMsg("Failed to create IOC entry for line %d: %s",
-		  lineNum,name);
-		exit(1);
-	    }
-	    iocTable.add(*pIoc);
+  // Finish the cache.  The analysis does not depend on it, so it is
+  // only reported if it cannot be written.
+    if(eventCache.isWriting()) {
+	if(eventCache.finish(iocNames,linesSkipped,lineCounts) != P_OK) {
+	    fprintf(infoFile,"Cannot write cache %s: %s\n",cacheFileName,
+	      eventCache.getErrorString());
+	} else if(verbose) {
+	    fprintf(infoFile,"Wrote cache %s\n",cacheFileName);
 	}
+    }
 
-      // Unlock
-	if(realTime) epicsMutexUnlock(lock);
+  // Stop the timer, wait for what it took to be printed, and wait for
+  // the shard workers to finish the events, so the groups are only used
+  // here
+    if(parseTimer) parseTimer->stop();
+    if(pOutputThread) pOutputThread->finish();
+    for(int i=0; i < nShards; i++) shards[i]->finish();
 
-#if DEBUG_LIMIT
-	if(lineNum >= LINE_LIMIT) break;
-#endif
+  // Print report, or write the export file instead
+    if(exportFileSpecified) {
+	if(exportGroups() != P_OK) goto ERROR;
+    } else {
+	report(defaultSortMode);
     }
 
-  // Print report
-    report(defaultSortMode);
-
   // Print how many lines were skipped.  This needs to be done because
   // if the format is wrong, for example, there is no user
   // notification otherwise.
-    if(linesSkipped > 0) printf("\n\nLines skipped: %d\n",linesSkipped);
+    if(linesSkipped > 0) {
+	fprintf(infoFile,"\n\nLines skipped: %d\n",linesSkipped);
+    }
+
+  // Print how many lines the filter dropped
+    if(verbose && nameFilter.isActive()) {
+	fprintf(infoFile,"\n\nLines filtered: %d\n",linesFiltered);
+    }
+
+  // Print how many lines there were of each format if they were mixed
+    if(verbose || (lineCounts[FT_CASW] > 0 && lineCounts[FT_OAG] > 0)) {
+	fprintf(infoFile,"\n\nCASW lines: %d\nOAG lines: %d\n",
+	  lineCounts[FT_CASW],lineCounts[FT_OAG]);
+    }
+    if(verbose) printPoolStats();
+    if(verbose && nHolds > 0) {
+	fprintf(infoFile,"Report holds: %d, %.3f ms mean, %.3f ms max\n",
+	  nHolds,holdTotal/nHolds*1000.,holdMax*1000.);
+    }
 
     goto FINISH;
 
@@ -331,8 +575,20 @@ int main(int argc, char **argv)
     retVal=1;
     
   FINISH:
-  // Close the file
-    fclose(caswFp);
+  // Write the rest of the output
+    output.close();
+    if(output.getStatus() != P_OK) retVal=1;
+
+  // Close the input
+    mappedFile.close();
+    lineReader.close();
+    eventCache.abandon();
+    eventCache.close();
+    if(caswFileNames) {
+	for(int i=0; i < nCaswFiles; i++) delete [] caswFileNames[i];
+	delete [] caswFileNames;
+	caswFileNames=NULL;
+    }
 
   // Free any existing arrays
     if(iocs) {
@@ -343,30 +599,463 @@ int main(int argc, char **argv)
 	delete [] groups;
 	groups=NULL;
     }
-    if(timeDiffs) {
-	delete [] timeDiffs;
-	timeDiffs=NULL;
+    if(timeKeys) {
+	delete [] timeKeys;
+	timeKeys=NULL;
+    }
+    if(timeTies) {
+	delete [] timeTies;
+	timeTies=NULL;
     }
     if(indices) {
 	delete [] indices;
 	indices=NULL;
     }
+    if(shardIds) {
+	delete [] shardIds;
+	shardIds=NULL;
+    }
     nArray=0;
 
-  // Empty the ioc list
-    resTableIter<CIoc,stringId> iter1(iocTable.firstIter());
-    while((pIoc=iter1.pointer())) {
-      // Increment first before deleting so we don't delete what the
-      // iter is pointing at
-        iter1++;
-      // Delete the CIoc which should remove all the groups from its
-      // list and delete them
-	delete pIoc;
+  // Delete the output thread unless it is still running after an error
+    if(pOutputThread && !pOutputThread->isStarted()) {
+	delete pOutputThread;
+	pOutputThread=NULL;
+    }
+
+  // Delete the shards, which deletes the CIocs and their groups.  A
+  // shard whose worker is still running after an error is left.
+    if(shards) {
+	for(int i=0; i < nShards; i++) {
+	    if(shards[i] && !shards[i]->isStarted()) delete shards[i];
+	}
+	delete [] shards;
+	shards=NULL;
+    }
+
+    return retVal;
+}
+
+// Returns 1 if the time is in the range of -from and -to.  Sets
+// pastRange when it is far enough past the end that the rest of the
+// input can be skipped.
+static inline int inRange(const epicsTime &time)
+{
+    if(fromSpecified && time < fromTime) return 0;
+    if(toSpecified && !(time < toTime)) {
+	if(!(time < stopTime)) pastRange=1;
+	return 0;
+    }
+    return 1;
+}
+
+// Parses one input line, which runs from start to end and is not
+// necessarily NUL terminated, and adds it to the servers and groups
+static void processLine(const char *start, const char *end, int lineNum)
+{
+    CaswLine caswLine;
+    epicsTime time;
+
+  // Only use lines that have all expected items
+    if(parseLine(start,end,fileType,&caswLine) != P_OK) {
+	linesSkipped++;
+	return;
+    }
+
+  // Convert the date and time.  A line whose time is bad is skipped
+  // whether or not its server is filtered out.
+    if(timeCache.getTime(&caswLine,&time) != P_OK) {
+	linesSkipped++;
+	return;
+    }
+  // Drop the servers that are filtered out before the name is used
+    if(!nameFilter.accepts(caswLine.name,caswLine.nameLen)) {
+	linesFiltered++;
+	return;
+    }
+    lineCounts[caswLine.fileType]++;
+
+#if DEBUG_PARSE
+    printf("%.*s",(int)(end-start),start);
+    printf("name=%.*s\n"
+      "year=%d month=%d day=%d hour=%d min=%d sec=%d nSec=%ld\n",
+      (int)caswLine.nameLen,caswLine.name,
+      caswLine.year,caswLine.month,caswLine.day,
+      caswLine.hour,caswLine.min,caswLine.sec,caswLine.nSec);
+    static char timeStampStr[512];
+    time.strftime(timeStampStr,20,"%b %d %H:%M:%S");
+    
+    printf("%s\n",timeStampStr);
+#endif
+
+  // Only use the lines in the time range
+    if((fromSpecified || toSpecified) && !inRange(time)) return;
+
+  // Echo the input lines
+    if(echo) fwrite(start,1,end-start,infoFile);
+
+    processEvent(caswLine.name,caswLine.nameLen,
+      CNameTable::hash(caswLine.name,caswLine.nameLen),time,lineNum);
+}
+
+// Adds a parsed line to the servers and groups of the shard for the
+// hash of its name, or passes it to the worker of the shard.  The name
+// is not necessarily NUL terminated, and hash is its
+// CNameTable::hash().
+static void processEvent(const char *name, size_t nameLen, unsigned hash,
+  epicsTime time, int lineNum)
+{
+    int id;
+
+  // Get the id of the name, adding it the first time it is seen.  The
+  // name is only copied then.  Only this thread uses the name table.
+    id=iocNames.intern(name,nameLen,hash);
+    if(eventCache.isWriting()) eventCache.add(id,time);
+
+    dispatchEvent(id,time,lineNum);
+}
+
+// Adds an event for a name that has been interned, as processEvent()
+// does
+static void dispatchEvent(int id, epicsTime time, int lineNum)
+{
+    CShard *pShard=shards[iocNames.getHash(id)%(unsigned)nShards];
+    if(pShard->isStarted()) {
+	RingRecord record;
+	record.type=RR_EVENT;
+	record.time=time;
+	record.name=iocNames.getName(id);
+	record.id=id;
+	record.lineNum=lineNum;
+      // With -live it is dropped and counted if the worker is behind.
+      // Otherwise this waits for the worker.
+	if(liveMode) pShard->getRing().push(record);
+	else pShard->getRing().pushWait(record);
+	return;
+    }
+
+    pShard->addEvent(iocNames.getName(id),id,time,lineNum);
+}
+
+// Opens the cache of the file if it can be used, or else starts
+// writing it.  The lines must be read to echo them, so it is only
+// written then.  The cache has the line counts of all the servers, and
+// not of those that -include and -exclude drop, so it is not used with
+// them, which keeps the counts the same as when the lines are read.
+static void openCache(void)
+{
+    epicsUInt32 options=makeStampedOptions(fileType,utc);
+
+    if(nameFilter.isActive()) {
+	if(verbose) {
+	    fprintf(infoFile,"Not using cache: It is not used with "
+	      "-include or -exclude\n");
+	}
+	return;
+    }
+    if(CEventCache::makeFileName(caswFileName,cacheFileName,
+	 sizeof(cacheFileName)) != P_OK) {
+	fprintf(infoFile,"Cannot use cache: File name is too long\n");
+	return;
+    }
+    if(!echo) {
+	if(eventCache.open(cacheFileName,caswFileName,options) == P_OK) {
+	    if(verbose) fprintf(infoFile,"Using cache %s\n",cacheFileName);
+	    return;
+	}
+	if(verbose) {
+	    fprintf(infoFile,"Not using cache %s: %s\n",cacheFileName,
+	      eventCache.getErrorString());
+	}
+    }
+  // The cache must have all the events
+    if(fromSpecified || toSpecified) return;
+    if(eventCache.create(cacheFileName,caswFileName,options) != P_OK) {
+	fprintf(infoFile,"Cannot write cache %s: %s\n",cacheFileName,
+	  eventCache.getErrorString());
+    }
+}
+
+// Adds the events from the cache, with the counts of the lines they
+// were parsed from.  A name is interned when its first event is used,
+// so the ids are in the order the servers are seen, as when the lines
+// are read, also when there is a time range.  Returns P_OK or
+// P_ERROR.
+static int processCache(void)
+{
+    int nNames=eventCache.getNameCount();
+    const char *name=eventCache.getNames();
+    int nEvents=0;
+    int id;
+    epicsTime time;
+
+  // The names in the cache and the ids they are given, or -1
+    const char **names=new const char *[nNames+1];
+    int *ids=new int[nNames+1];
+    if(!names || !ids) {
+	errMsg("Cannot allocate space for cache names");
+	exit(1);
+    }
+    for(int i=0; i < nNames; i++) {
+	names[i]=name;
+	ids[i]=-1;
+	name+=strlen(name)+1;
+    }
+
+    while(eventCache.next(&id,&time)) {
+	nEvents++;
+	if((fromSpecified || toSpecified) && !inRange(time)) {
+	    if(pastRange) break;
+	    continue;
+	}
+	if(ids[id] < 0) {
+	    size_t len=strlen(names[id]);
+	    ids[id]=iocNames.intern(names[id],len,
+	      CNameTable::hash(names[id],len));
+	}
+	dispatchEvent(ids[id],time,nEvents);
+    }
+    delete [] ids;
+    delete [] names;
+    if(eventCache.getErrorString()) {
+	errMsg("Error reading %s after event %d:\n%s\n",cacheFileName,
+	  nEvents,eventCache.getErrorString());
+	return P_ERROR;
+    }
+
+    linesSkipped+=eventCache.getLinesSkipped();
+    for(int type=0; type < FT_NFORMATS; type++) {
+	lineCounts[type]+=eventCache.getLineCount((CaswFileType)type);
+    }
+
+    return P_OK;
+}
+
+// Reads the lines of the mapped file from where the time range starts
+// until they are past its end
+static void processRange(CMappedFile &mappedFile)
+{
+    const char *end=mappedFile.getEnd();
+    const char *lineEnd;
+    int lineNum=0;
+
+    for(const char *cur=findRangeStart(mappedFile); cur < end;
+	cur=lineEnd) {
+	lineEnd=CMappedFile::frameLine(cur,end);
+	lineNum++;
+	processLine(cur,lineEnd,lineNum);
+	if(pastRange) break;
+    }
+}
+
+// Returns where to start reading for -from.  The index is used if it is
+// up to date.  With -index it is built if it is not, else the lines are
+// found by a binary search.
+static const char *findRangeStart(CMappedFile &mappedFile)
+{
+    CTimeIndex timeIndex;
+    char indexFileName[PATH_MAX];
+    epicsUInt32 options=makeStampedOptions(fileType,utc);
+
+    if(CTimeIndex::makeFileName(caswFileName,indexFileName,
+	 sizeof(indexFileName)) != P_OK) {
+	fprintf(infoFile,"Cannot use index: File name is too long\n");
+	indexFileName[0]='\0';
+    } else if(timeIndex.open(indexFileName,caswFileName,options) == P_OK) {
+	if(verbose) fprintf(infoFile,"Using index %s\n",indexFileName);
+    } else if(useIndex) {
+	timeIndex.build(mappedFile,fileType,timeCache);
+	if(timeIndex.write(indexFileName,caswFileName,options) != P_OK) {
+	    fprintf(infoFile,"Cannot write index %s: %s\n",indexFileName,
+	      timeIndex.getErrorString());
+	} else if(verbose) {
+	    fprintf(infoFile,"Wrote index %s with %d entries\n",
+	      indexFileName,timeIndex.getCount());
+	}
+    }
+
+    if(!fromSpecified) return mappedFile.getBegin();
+    epicsTime startTime=fromTime-RANGE_SLACK;
+    if(timeIndex.isOpen()) return timeIndex.findStart(mappedFile,startTime);
+    return CTimeIndex::searchStart(mappedFile,fileType,timeCache,startTime);
+}
+
+// Splits the mapped file into nJobs chunks of whole lines, analyzes
+// them in parallel, and merges the results into the one shard in
+// order.  The result is the same as processing the lines in order.
+static void processChunks(CMappedFile &mappedFile)
+{
+    const char *begin=mappedFile.getBegin();
+    const char *end=mappedFile.getEnd();
+    size_t size=mappedFile.getSize();
+    const char *start=begin;
+    const char *chunkEnd;
+    int i;
+
+    CChunk **chunks=new CChunk *[nJobs];
+    if(!chunks) {
+	errMsg("Cannot allocate space for chunks array");
+	exit(1);
     }
 
+  // Make the chunks, ending each one after a newline.  The first
+  // valid line of a chunk must not have a local time that occurs
+  // twice, since that depends on the line before.
+    for(i=0; i < nJobs; i++) {
+	if(i == nJobs-1) {
+	    chunkEnd=end;
+	} else {
+	    chunkEnd=begin+(size_t)((double)size*(i+1)/nJobs);
+	    if(chunkEnd < start) chunkEnd=start;
+	    const char *nl=(const char *)memchr(chunkEnd,'\n',end-chunkEnd);
+	    chunkEnd=nl?nl+1:end;
+	    while(chunkEnd < end) {
+		CaswLine caswLine;
+		const char *lineEnd=CMappedFile::frameLine(chunkEnd,end);
+		if(parseLine(chunkEnd,lineEnd,fileType,&caswLine) == P_OK &&
+		  !timeCache.isAmbiguous(&caswLine)) break;
+		chunkEnd=lineEnd;
+	    }
+	}
+	chunks[i]=new CChunk(start,chunkEnd,fileType,timeCache,nameFilter,
+	  NEW_GROUP_TIME);
+	if(!chunks[i]) {
+	    errMsg("Cannot allocate space for chunk");
+	    exit(1);
+	}
+	start=chunkEnd;
+    }
+
+  // Start the threads.  Do the chunk here if a thread cannot start.
+    for(i=0; i < nJobs; i++) {
+	if(chunks[i]->start() != P_OK) chunks[i]->run();
+    }
+
+  // Merge them in order as they finish
+    for(i=0; i < nJobs; i++) {
+	chunks[i]->wait();
+	chunks[i]->merge(iocNames,shards[0]->getIocTable(),
+	  shards[0]->getGroupStore());
+	linesSkipped+=chunks[i]->getLinesSkipped();
+	linesFiltered+=chunks[i]->getLinesFiltered();
+	for(int type=0; type < FT_NFORMATS; type++) {
+	    lineCounts[type]+=chunks[i]->getLineCount((CaswFileType)type);
+	}
+	delete chunks[i];
+    }
+    delete [] chunks;
+}
+
+// Parses each of the files on its own thread and merges their lines in
+// time order, so that the files can be from different subnets.  Lines
+// with the same time are taken in the order the files were given.
+// Returns P_OK or P_ERROR.
+static int processFiles(void)
+{
+    CMergeHeap heap(nCaswFiles);
+    CFileSource *pSource;
+    int retVal=P_OK;
+    int i;
+
+    CFileSource **sources=new CFileSource *[nCaswFiles];
+    if(!sources) {
+	errMsg("Cannot allocate space for sources array");
+	exit(1);
+    }
+    for(i=0; i < nCaswFiles; i++) sources[i]=NULL;
+
+  // Open them all first so they are all checked before any output
+    for(i=0; i < nCaswFiles; i++) {
+	sources[i]=new CFileSource(i,fileType,timeCache,nameFilter);
+	if(!sources[i]) {
+	    errMsg("Cannot allocate space for source");
+	    exit(1);
+	}
+	if(sources[i]->open(caswFileNames[i]) != P_OK) {
+	    errMsg("Cannot read file:\n%s\n%s",caswFileNames[i],
+	      sources[i]->getErrorString());
+	    retVal=P_ERROR;
+	    goto END;
+	}
+    }
+
+  // Start the threads
+    for(i=0; i < nCaswFiles; i++) {
+	if(sources[i]->start() != P_OK) {
+	    errMsg("Cannot start thread for:\n%s",caswFileNames[i]);
+	    retVal=P_ERROR;
+	    goto END;
+	}
+    }
+
+  // Merge
+    for(i=0; i < nCaswFiles; i++) {
+	if(sources[i]->next()) heap.push(sources[i]);
+    }
+    while((pSource=heap.top())) {
+	const CaswEvent &event=pSource->getEvent();
+      // The sources are read to the end, so they finish
+	if(!(fromSpecified || toSpecified) || inRange(event.time)) {
+	    if(echo) fwrite(pSource->getLine(),1,event.lineLen,infoFile);
+	    processEvent(pSource->getName(),event.nameLen,event.hash,
+	      event.time,event.lineNum);
+	}
+	if(pSource->next()) heap.replaceTop();
+	else heap.pop();
+    }
+
+    for(i=0; i < nCaswFiles; i++) {
+	linesSkipped+=sources[i]->getLinesSkipped();
+	linesFiltered+=sources[i]->getLinesFiltered();
+	for(int type=0; type < FT_NFORMATS; type++) {
+	    lineCounts[type]+=sources[i]->getLineCount((CaswFileType)type);
+	}
+	if(sources[i]->getStatus() != P_OK) {
+	    errMsg("Error reading %s:\n%s",caswFileNames[i],
+	      sources[i]->getErrorString());
+	    retVal=P_ERROR;
+	}
+    }
+
+  END:
+    for(i=0; i < nCaswFiles; i++) {
+	if(sources[i]) delete sources[i];
+    }
+    delete [] sources;
+
     return retVal;
 }
 
+// Gets the beacon anomalies from the listener and adds them to the
+// servers and groups.  It only returns on an error, with P_ERROR.
+static int processBeacons(CBeaconListener &beaconListener)
+{
+    const char *name;
+    size_t nameLen;
+    unsigned hash;
+    epicsTime time;
+    char timeString[64];
+    int nAnomalies=0;
+
+    while(beaconListener.getAnomaly(&name,&nameLen,&hash,&time) == P_OK) {
+	nAnomalies++;
+	if(!nameFilter.accepts(name,nameLen)) {
+	    linesFiltered++;
+	    continue;
+	}
+      // Echo in the same format as casw
+	if(echo) {
+	    time.strftime(timeString,sizeof(timeString),
+	      "%Y-%m-%d %H:%M:%S.%09f");
+	    fprintf(infoFile,"%-40s %s\n",name,timeString);
+	    fflush(infoFile);
+	}
+	processEvent(name,nameLen,hash,time,nAnomalies);
+    }
+
+    return P_ERROR;
+}
+
 static int parseCommand(int argc, char **argv)
 {
     int intVal;
@@ -374,13 +1063,146 @@ static int parseCommand(int argc, char **argv)
     for(int i=1; i < argc; i++) {
 	if (argv[i][0] == '-') {
 	    switch(argv[i][1]) {
+	    case 'b':
+		beaconMode=1;
+		break;
+	    case 'c':
+	      // Long options must be given in full
+		if(!strcmp(argv[i],"-cache")) {
+		    useCache=1;
+		    break;
+		}
+		errMsg("\nInvalid option: %s",argv[i]);
+		usage();
+		return P_ERROR;
+	    case 'f':
+	      // Long options must be given in full
+		if(!strcmp(argv[i],"-from")) {
+		    i++;
+		    if(i >= argc) {
+			errMsg("\nNo value specified for from");
+			doUsage=1;
+			return P_ERROR;
+		    }
+		    if(parseTimeOption(argv[i],&fromLine) != P_OK) {
+			errMsg("\nInvalid from time: %s",argv[i]);
+			doUsage=1;
+			return P_ERROR;
+		    }
+		    fromSpecified=1;
+		    break;
+		}
+		if(!strcmp(argv[i],"-format")) {
+		    i++;
+		    if(i >= argc) {
+			errMsg("\nNo value specified for format");
+			doUsage=1;
+			return P_ERROR;
+		    }
+		    if(!strcmp(argv[i],"text")) {
+			records.setFormat(RF_TEXT);
+		    } else if(!strcmp(argv[i],"jsonl")) {
+			records.setFormat(RF_JSONL);
+		    } else if(!strcmp(argv[i],"csv")) {
+			records.setFormat(RF_CSV);
+		    } else {
+			errMsg("\nInvalid format: %s",argv[i]);
+			doUsage=1;
+			return P_ERROR;
+		    }
+		    break;
+		}
+		errMsg("\nInvalid option: %s",argv[i]);
+		usage();
+		return P_ERROR;
 	    case 'h':
 		doUsage=1;
 		break;
 	    case 'e':
+	      // Long options must be given in full
+		if(!strcmp(argv[i],"-expected-servers")) {
+		    i++;
+		    if(i >= argc) {
+			errMsg("\nNo value specified for expected servers");
+			doUsage=1;
+			return P_ERROR;
+		    }
+		    intVal=atoi(argv[i]);
+		    if(intVal <= 0) {
+			errMsg("\nInvalid number of expected servers: %s",
+			  argv[i]);
+			doUsage=1;
+			return P_ERROR;
+		    }
+		    expectedServers=intVal;
+		    break;
+		}
+		if(!strcmp(argv[i],"-exclude")) {
+		    i++;
+		    if(i >= argc) {
+			errMsg("\nNo value specified for exclude");
+			doUsage=1;
+			return P_ERROR;
+		    }
+		    if(nameFilter.addExclude(argv[i]) != P_OK) {
+			errMsg("\nInvalid exclude pattern: %s",argv[i]);
+			doUsage=1;
+			return P_ERROR;
+		    }
+		    break;
+		}
+		if(!strcmp(argv[i],"-export")) {
+		    i++;
+		    if(i >= argc) {
+			errMsg("\nNo value specified for export");
+			doUsage=1;
+			return P_ERROR;
+		    }
+		    if(strlen(argv[i]) >= PATH_MAX) {
+			errMsg("\nFile name is too long: %s",argv[i]);
+			return P_ERROR;
+		    }
+		    strcpy(exportFileName,argv[i]);
+		    exportFileSpecified=1;
+		    break;
+		}
 		echo=1;
 		break;
 	    case 'i':
+	      // Long options must be given in full
+		if(!strcmp(argv[i],"-import")) {
+		    i++;
+		    if(i >= argc) {
+			errMsg("\nNo value specified for import");
+			doUsage=1;
+			return P_ERROR;
+		    }
+		    if(strlen(argv[i]) >= PATH_MAX) {
+			errMsg("\nFile name is too long: %s",argv[i]);
+			return P_ERROR;
+		    }
+		    strcpy(importFileName,argv[i]);
+		    importFileSpecified=1;
+		    break;
+		}
+		if(!strcmp(argv[i],"-include")) {
+		    i++;
+		    if(i >= argc) {
+			errMsg("\nNo value specified for include");
+			doUsage=1;
+			return P_ERROR;
+		    }
+		    if(nameFilter.addInclude(argv[i]) != P_OK) {
+			errMsg("\nInvalid include pattern: %s",argv[i]);
+			doUsage=1;
+			return P_ERROR;
+		    }
+		    break;
+		}
+		if(!strcmp(argv[i],"-index")) {
+		    useIndex=1;
+		    break;
+		}
 		i++;
 		if(i >= argc) {
 		    errMsg("\nNo value specified for interval");
@@ -395,6 +1217,51 @@ static int parseCommand(int argc, char **argv)
 		}
 		timerInterval=(unsigned)intVal;
 		break;
+	    case 'j':
+		i++;
+		if(i >= argc) {
+		    errMsg("\nNo value specified for jobs");
+		    doUsage=1;
+		    return P_ERROR;
+		}
+		intVal=atoi(argv[i]);
+		if(intVal <= 0) {
+		    errMsg("\nInvalid number of jobs: %s",argv[i]);
+		    doUsage=1;
+		    return P_ERROR;
+		}
+		nJobs=intVal;
+		break;
+	    case 'm':
+	      // Long options must be given in full
+		if(!strcmp(argv[i],"-max-mem")) {
+		    i++;
+		    if(i >= argc) {
+			errMsg("\nNo value specified for max-mem");
+			doUsage=1;
+			return P_ERROR;
+		    }
+		    intVal=atoi(argv[i]);
+		    if(intVal <= 0) {
+			errMsg("\nInvalid max-mem: %s",argv[i]);
+			doUsage=1;
+			return P_ERROR;
+		    }
+		    maxMem=(size_t)intVal*1024*1024;
+		    break;
+		}
+		errMsg("\nInvalid option: %s",argv[i]);
+		usage();
+		return P_ERROR;
+	    case 'l':
+	      // Long options must be given in full
+		if(!strcmp(argv[i],"-live")) {
+		    liveMode=1;
+		    break;
+		}
+		errMsg("\nInvalid option: %s",argv[i]);
+		usage();
+		return P_ERROR;
 	    case 'o':
 		fileType=FT_OAG;
 		break;
@@ -404,6 +1271,23 @@ static int parseCommand(int argc, char **argv)
 		break;
 #endif
 	    case 's':
+	      // Long options must be given in full
+		if(!strcmp(argv[i],"-shards")) {
+		    i++;
+		    if(i >= argc) {
+			errMsg("\nNo value specified for shards");
+			doUsage=1;
+			return P_ERROR;
+		    }
+		    intVal=atoi(argv[i]);
+		    if(intVal <= 0) {
+			errMsg("\nInvalid number of shards: %s",argv[i]);
+			doUsage=1;
+			return P_ERROR;
+		    }
+		    nShards=intVal;
+		    break;
+		}
 		defaultSortMode=SORT_IOC;
 		break;
 	    case 'v':
@@ -413,22 +1297,34 @@ static int parseCommand(int argc, char **argv)
 		printf("Version: %s\n",PARSECASW_VERSION_STRING);
 		exit(0);
 	    case 't':
+	      // Long options must be given in full
+		if(!strcmp(argv[i],"-to")) {
+		    i++;
+		    if(i >= argc) {
+			errMsg("\nNo value specified for to");
+			doUsage=1;
+			return P_ERROR;
+		    }
+		    if(parseTimeOption(argv[i],&toLine) != P_OK) {
+			errMsg("\nInvalid to time: %s",argv[i]);
+			doUsage=1;
+			return P_ERROR;
+		    }
+		    toSpecified=1;
+		    break;
+		}
 		terse=1;
 		break;
+	    case 'u':
+		utc=1;
+		break;
 	    default:
 		errMsg("\nInvalid option: %s",argv[i]);
 		usage();
 		return P_ERROR;
 	    }
 	} else {
-	    if(!caswFileSpecified) {
-		strcpy(caswFileName,argv[i]);
-		caswFileSpecified=1;
-	    } else {
-		errMsg("\nInvalid option: %s",argv[i]);
-		doUsage=1;
-		return P_ERROR;
-	    }
+	    if(addFileNames(argv[i]) != P_OK) return P_ERROR;
 	}
     }
 #if 0
@@ -442,32 +1338,231 @@ static int parseCommand(int argc, char **argv)
     return P_OK;
 }
 
+// Parses a time for -from or -to, which is YYYY-MM-DD, optionally
+// followed by a space or T and HH:MM or HH:MM:SS, with - or / in the
+// date as in the input.  Returns P_OK or P_ERROR.
+static int parseTimeOption(const char *string, CaswLine *pLine)
+{
+    int n=0;
+
+    memset(pLine,0,sizeof(CaswLine));
+    if(sscanf(string,"%4d%*1[-/]%2d%*1[-/]%2d%n",&pLine->year,
+	 &pLine->month,&pLine->day,&n) != 3 || !n) {
+	return P_ERROR;
+    }
+    string+=n;
+    if(*string == ' ' || *string == 'T') {
+	n=0;
+	if(sscanf(string+1,"%2d:%2d%n",&pLine->hour,&pLine->min,&n) != 2 ||
+	  !n) {
+	    return P_ERROR;
+	}
+	string+=n+1;
+	if(*string == ':') {
+	    n=0;
+	    if(sscanf(string+1,"%2d%n",&pLine->sec,&n) != 1 || !n) {
+		return P_ERROR;
+	    }
+	    string+=n+1;
+	}
+    }
+    if(*string) return P_ERROR;
+    if(pLine->month < 1 || pLine->month > 12 ||
+      pLine->day < 1 || pLine->day > 31 ||
+      pLine->hour < 0 || pLine->hour > 23 ||
+      pLine->min < 0 || pLine->min > 59 ||
+      pLine->sec < 0 || pLine->sec > 59) {
+	return P_ERROR;
+    }
+
+    return P_OK;
+}
+
+// Converts -from and -to the same as the times of the lines, which must
+// be done after the time zone is set.  Returns P_OK or P_ERROR.
+static int convertRange(void)
+{
+    CTimeCache rangeCache=timeCache;
+
+    if(fromSpecified &&
+      rangeCache.getTime(&fromLine,&fromTime) != P_OK) {
+	errMsg("\nCannot convert the from time");
+	return P_ERROR;
+    }
+    if(toSpecified) {
+	if(rangeCache.getTime(&toLine,&toTime) != P_OK) {
+	    errMsg("\nCannot convert the to time");
+	    return P_ERROR;
+	}
+	stopTime=toTime+RANGE_SLACK;
+    }
+
+    return P_OK;
+}
+
+// Adds the files that match a wildcard pattern, which is usually only
+// necessary if it was quoted, or else the file itself
+static int addFileNames(const char *pattern)
+{
+#ifndef WIN32
+    if(strpbrk(pattern,"*?[")) {
+	glob_t globBuf;
+	int status=glob(pattern,0,NULL,&globBuf);
+	if(status == GLOB_NOMATCH) {
+	    errMsg("\nNo files match: %s",pattern);
+	    return P_ERROR;
+	} else if(status) {
+	    errMsg("\nCannot expand: %s",pattern);
+	    return P_ERROR;
+	}
+	for(size_t i=0; i < globBuf.gl_pathc; i++) {
+	    if(addFileName(globBuf.gl_pathv[i]) != P_OK) {
+		globfree(&globBuf);
+		return P_ERROR;
+	    }
+	}
+	globfree(&globBuf);
+	return P_OK;
+    }
+#endif
+    return addFileName(pattern);
+}
+
+static int addFileName(const char *name)
+{
+    size_t len=strlen(name);
+    if(len >= PATH_MAX) {
+	errMsg("\nFile name is too long: %s",name);
+	return P_ERROR;
+    }
+
+    if(nCaswFiles >= caswFileNamesSize) {
+	int newSize=caswFileNamesSize?2*caswFileNamesSize:16;
+	char **newNames=new char *[newSize];
+	if(!newNames) {
+	    errMsg("Cannot allocate space for file names");
+	    exit(1);
+	}
+	for(int i=0; i < nCaswFiles; i++) newNames[i]=caswFileNames[i];
+	if(caswFileNames) delete [] caswFileNames;
+	caswFileNames=newNames;
+	caswFileNamesSize=newSize;
+    }
+    caswFileNames[nCaswFiles]=new char[len+1];
+    if(!caswFileNames[nCaswFiles]) {
+	errMsg("Cannot allocate space for file name");
+	exit(1);
+    }
+    strcpy(caswFileNames[nCaswFiles],name);
+
+  // The first one is used when there is only one
+    if(!nCaswFiles) strcpy(caswFileName,name);
+    nCaswFiles++;
+    caswFileSpecified=1;
+
+    return P_OK;
+}
+
 static void usage(void)
 {
     printf(
       "\nParseCASW\n\n"
-      "Usage: parsecasw [Options] [filename]\n"
+      "Usage: parsecasw [Options] [filename...]\n"
       "       casw | parsecasw [Options]\n"
+      "       parsecasw -beacon [Options]\n"
+      "       parsecasw -import <file> [Options]\n"
       "  Parses CASW output and divides it into groups of beacon anomalies.\n"
       "  Reads from stdin if no filename is specified.\n"
+      "  Files compressed with gzip, xz, or zstd are decompressed as they\n"
+      "  are read, if this build supports them.\n"
+      "  Several files or quoted wildcard patterns may be given, for\n"
+      "  example one for each subnet.  Each file is parsed by its own\n"
+      "  thread, and their lines are merged in time order.\n"
       "\n"
       "  Version: %s\n"
       "\n"
-      "  Options (First character is sufficient):\n"
+      "  Options (First character is sufficient except as noted):\n"
       "    -help        This message.  Use with -v for more information.\n"
+      "    -beacon      Listen for beacons on EPICS_CA_REPEATER_PORT and find\n"
+      "                 the anomalies the same way as casw instead of\n"
+      "                 reading its output.  Use -echo to print them.\n"
+      "    -cache       Keep the parsed events of the file in <file>.pcache\n"
+      "                 and use them instead of parsing it again while\n"
+      "                 its size and time and -oag and -utc are the same.\n"
+      "                 It is not used with -include or -exclude.  Must be\n"
+      "                 given in full.\n"
       "    -echo        Echo input lines\n"
+      "    -exclude <pattern>\n"
+      "                 Drop the lines of the servers that match, before\n"
+      "                 they are analyzed.  The pattern is a name, or has\n"
+      "                 one * for any text, as in ioc-li2* or *:5064.  May\n"
+      "                 be repeated.  Must be given in full.\n"
+      "    -expected-servers <int>\n"
+      "                 Size the server table for this many servers.\n"
+      "                 Must be given in full.  (Default is to grow as\n"
+      "                 needed)\n"
+      "    -export <file>\n"
+      "                 Write the servers and groups to this binary file\n"
+      "                 instead of printing the report.  Must be given\n"
+      "                 in full.\n"
+      "    -from <time> Only use the events at or after this time, which is\n"
+      "                 YYYY-MM-DD [HH:MM[:SS]].  With an index, or by a\n"
+      "                 binary search of a plain file, the lines before it\n"
+      "                 are not read.  Must be given in full.\n"
+      "    -format <text|jsonl|csv>\n"
+      "                 Print one JSON object per line or one CSV row for\n"
+      "                 each group, or each server with -server.  Times\n"
+      "                 and intervals are in integer nanoseconds.  Other\n"
+      "                 output goes to stderr.  Must be given in full.\n"
+      "                 (Default is text)\n"
+      "    -import <file>\n"
+      "                 Print the report from a file written by -export\n"
+      "                 instead of reading input.  The output options\n"
+      "                 apply as usual.  Must be given in full.\n"
+      "    -include <pattern>\n"
+      "                 Only use the lines of the servers that match, in\n"
+      "                 the same form as -exclude, which is applied after.\n"
+      "                 May be repeated.  Must be given in full.\n"
+      "    -index       Use and if needed make <file>.pindex, which has the\n"
+      "                 offsets of the lines every %d sec, to find where\n"
+      "                 -from starts in a plain file.  Must be given in\n"
+      "                 full.  (Default is to use it if it is up to date)\n"
       "    -int <int>   Do checking and output at this interval when reading\n"
       "                 from stdin. (Default is %u sec)\n"
-      "    -oag         Use OAG data logger format (Default is CASW output)\n"
+      "    -jobs <int>  Analyze a single file in this many parallel chunks.\n"
+      "                 The results are the same.  (Default is 1)\n"
+      "    -live        Drop events from stdin or -beacon if the analysis\n"
+      "                 falls behind, instead of waiting for it.  How many\n"
+      "                 were dropped is printed before each report.  Must\n"
+      "                 be given in full.  (Default is to wait)\n"
+      "    -max-mem <MiB>\n"
+      "                 Compact finished groups into summaries when the\n"
+      "                 groups and summaries use more than this.  Must be\n"
+      "                 given in full.  Files are then analyzed in one\n"
+      "                 job.  (Default is to keep all groups)\n"
+      "    -oag         Only accept OAG data logger format (Default is to\n"
+      "                 accept CASW output and OAG format line by line)\n"
 #if 0
       "    -real        Write blocks in real time (Use stdin, ignore -server)\n"
 #endif
       "    -server      Sort by server (Default is by group)\n"
+      "    -shards <int>\n"
+      "                 Divide the servers among this many threads by the\n"
+      "                 hash of their names.  The results are the same.\n"
+      "                 Must be given in full.  Files are then analyzed\n"
+      "                 in one job.  (Default is 1)\n"
+      "    -to <time>   Only use the events before this time, in the same\n"
+      "                 form as -from.  The rest of the lines are not\n"
+      "                 read.  Must be given in full.\n"
       "    -terse       Terse output (Default is between terse and verbose)\n"
+      "    -utc         Times in the input are UTC.  Times are also printed\n"
+      "                 in UTC.  (Default is local time)\n"
       "    -Version     Print the version\n"
       "    -verbose     Verbose output.  When used with -h produces more\n"
-      "                 extensive help information.\n"
-	,PARSECASW_VERSION_STRING,TIMER_INTERVAL);
+      "                 extensive help information.  In real time it\n"
+      "                 also prints how long each report stopped the\n"
+      "                 analysis.\n"
+	,PARSECASW_VERSION_STRING,INDEX_INTERVAL,TIMER_INTERVAL);
 
     if(verbose) {
 	int nLines=sizeof(helpTxt)/sizeof(char *);
@@ -477,28 +1572,122 @@ static void usage(void)
 
 static void report(SortMode sortMode)
 {
-    if(sortMode == SORT_FINISHED) {
-	sortByGroup(sortMode);
-	if(nArray > 0) {
-	    reportByGroup();
-	    removeFinished();
-	}
-    } else if(sortMode == SORT_GROUP) {
+  // The report goes through the output buffers, after what has been
+  // printed, and is written before anything else is printed
+    fflush(stdout);
+    printDrops();
+    if(sortMode == SORT_GROUP) {
 	sortByGroup(sortMode);
 	if(nArray > 0) reportByGroup();
     } else {
 	sortByIoc();
 	if(nArray > 0) reportByIoc();
     }
+    output.flush();
 }
 
 
-static void sortByIoc(void)
+// Takes the finished groups in report order and removes them, along
+// with the usage of the shards if verbose.  The shards must be paused.
+// This only copies the summaries, so it takes time in proportion to
+// the finished groups.  Returns NULL if there are none.
+static CSnapshot *takeSnapshot(void)
 {
-  // Get a time to difference against (epicsTime only understands
-  // differences)
-    epicsTime curTime=epicsTime::getCurrent();
+    GroupSummary summary;
+    int i,index,group;
+
+    sortByGroup(SORT_FINISHED);
+    if(nArray <= 0) return NULL;
+
+    CSnapshot *pSnapshot=new CSnapshot(nArray,verbose?nShards:0,
+      SHARD_STATS_SIZE);
+    if(!pSnapshot) {
+	errMsg("Cannot allocate space for snapshot");
+	exit(1);
+    }
+    for(i=0; i < nArray; i++) {
+	index=indices[i];
+	group=groups[index];
+	CShard &shard=*shards[shardIds[index]];
+	shard.getGroupStore().summarize(group,summary);
+	pSnapshot->add(shard.getIocTable().lookup(summary.iocId)->getName(),
+	  summary);
+    }
+    removeFinished();
+    for(i=0; i < pSnapshot->getStatsCount(); i++) {
+	shards[i]->formatStats(pSnapshot->getStats(i),
+	  pSnapshot->getStatsSize());
+    }
+
+    return pSnapshot;
+}
+
+// Prints the finished groups that were taken by the timer.  It is
+// called on the output thread, so it only uses the snapshot, and the
+// rings, which are safe to read while the shards run.  The reader may
+// be echoing lines to stdout, so stdout is locked until the groups are
+// written, which keeps the echoed lines whole.
+static void printSnapshot(const CSnapshot &snapshot)
+{
+#ifdef WIN32
+    _lock_file(stdout);
+#else
+    flockfile(stdout);
+#endif
+    fflush(stdout);
+    printDrops();
+    for(int i=0; i < snapshot.getCount(); i++) {
+	printGroup(snapshot.getName(i),snapshot.getSummary(i));
+    }
+    output.flush();
+#ifdef WIN32
+    _unlock_file(stdout);
+#else
+    funlockfile(stdout);
+#endif
+    if(snapshot.getStatsCount() > 0) {
+	printPoolStats(&snapshot);
+	fprintf(infoFile,"Report hold: %.3f ms\n",
+	  snapshot.getHoldTime()*1000.);
+    }
+}
+
+// Prints how many events the shard workers could not keep up with at
+// the head of a report, so it is seen with the groups it affects.  The
+// rings are safe to read while the shards run.
+static void printDrops(void)
+{
+    unsigned nDrops=0;
+
+    for(int i=0; i < nShards; i++) nDrops+=shards[i]->getDrops();
+    if(!nDrops) return;
+    if(records.getFormat() == RF_TEXT) {
+	output.format("\nEvents dropped: %u\n",nDrops);
+    } else {
+	fprintf(infoFile,"Events dropped: %u\n",nDrops);
+    }
+}
+
+// Returns a time in integer nanoseconds, which is used as the sort key
+static inline long long timeKey(const epicsTimeStamp &stamp)
+{
+    return (long long)stamp.secPastEpoch*1000000000LL+stamp.nsec;
+}
 
+// Returns a time in integer nanoseconds since the POSIX epoch
+static inline long long unixTimeKey(const epicsTimeStamp &stamp)
+{
+    return timeKey(stamp)+(long long)POSIX_TIME_AT_EPICS_EPOCH*1000000000LL;
+}
+
+static inline long long timeKey(const epicsTime &time)
+{
+    epicsTimeStamp stamp=time;
+    return timeKey(stamp);
+}
+
+static void sortByIoc(void)
+{
   // Free any existing arrays
     if(iocs) {
 	delete [] iocs;
@@ -508,25 +1697,30 @@ static void sortByIoc(void)
 	delete [] groups;
 	groups=NULL;
     }
-    if(timeDiffs) {
-	delete [] timeDiffs;
-	timeDiffs=NULL;
+    if(timeKeys) {
+	delete [] timeKeys;
+	timeKeys=NULL;
+    }
+    if(timeTies) {
+	delete [] timeTies;
+	timeTies=NULL;
     }
     if(indices) {
 	delete [] indices;
 	indices=NULL;
     }
+    if(shardIds) {
+	delete [] shardIds;
+	shardIds=NULL;
+    }
     nArray=0;
 
   // Get the number of entries
     CIoc *pIoc;
     int i=0;
-    resTableIter<CIoc,stringId> iter1(iocTable.firstIter());
-    while((pIoc=iter1.pointer())) {
-	i++;
-        iter1++;
+    for(int s=0; s < nShards; s++) {
+	nArray+=shards[s]->getIocTable().count();
     }
-    nArray=i;
 
   // Allocate arrays
     if(!nArray) return;
@@ -535,9 +1729,14 @@ static void sortByIoc(void)
 	errMsg("Cannot allocate space for IOC array");
 	exit(1);
     }
-    timeDiffs=new double[nArray];
-    if(!timeDiffs) {
-	errMsg("Cannot allocate space for timeDiffs array");
+    timeKeys=new long long[nArray];
+    if(!timeKeys) {
+	errMsg("Cannot allocate space for timeKeys array");
+	exit(1);
+    }
+    timeTies=new int[nArray];
+    if(!timeTies) {
+	errMsg("Cannot allocate space for timeTies array");
 	exit(1);
     }
     indices=new int[nArray];
@@ -545,22 +1744,32 @@ static void sortByIoc(void)
 	errMsg("Cannot allocate space for indices array");
 	exit(1);
     }
+    shardIds=new int[nArray];
+    if(!shardIds) {
+	errMsg("Cannot allocate space for shardIds array");
+	exit(1);
+    }
 
   // Fill in arrays
-  // Loop over the iocTable
-    iter1=iocTable.firstIter();
+  // Loop over the iocTable of each shard
     i=0;
-    while((pIoc=iter1.pointer())) {
-	epicsTime time=pIoc->getFirstTime();
-	timeDiffs[i]=time-curTime;
-	indices[i]=i;
-	iocs[i]=pIoc;
-	i++;
-        iter1++;
+    for(int s=0; s < nShards; s++) {
+	CIocTable &iocTable=shards[s]->getIocTable();
+	for(int id=0; id < iocTable.getSize(); id++) {
+	    pIoc=iocTable.lookup(id);
+	    if(!pIoc) continue;
+	    timeKeys[i]=timeKey(pIoc->getFirstTime());
+	    timeTies[i]=id;
+	    iocs[i]=pIoc;
+	    shardIds[i]=s;
+	    i++;
+	}
     }
 
-  // Sort
-    hsort(timeDiffs,indices,nArray);
+  // Sort.  Each shard is a run of servers in id order, and msort merges
+  // the runs it finds.  Equal times are put in id order, as with one
+  // shard.
+    msort(timeKeys,timeTies,indices,nArray);
 
     return;
 }
@@ -573,89 +1782,169 @@ static void reportByIoc()
     for(i=0; i < nArray; i++) {
 	index=indices[i];
 	pIoc=iocs[index];
-	printIoc(pIoc);
+	printIoc(*shards[shardIds[index]],pIoc);
     }
 }
 
-static void printIoc(CIoc *pIoc)
+static void printIoc(CShard &shard, CIoc *pIoc)
 {
-    char timeStampStr1[16];
-    char timeStampStr2[16];
+    CGroupStore &groupStore=shard.getGroupStore();
+    CSummaryStore &summaryStore=shard.getSummaryStore();
+    IocSummary iocSummary;
+    GroupSummary summary;
     
-    printf("\n%s\n",pIoc->resourceName());
+    pIoc->summarize(iocSummary);
+    if(!printIocHeader(pIoc->getName(),iocSummary)) return;
+    
+  // The compacted groups are before the others
+    int groupNum=1;
+    int slot=pIoc->getSummarySlot();
+    if(slot >= 0) {
+	for(int index=0; index < summaryStore.getCount(slot); index++) {
+	    summaryStore.get(slot,index,summary);
+	    printIocGroup(groupNum++,summary);
+	}
+    }
+    for(int group=pIoc->getFirstGroup(); group >= 0;
+	group=groupStore.getNext(group)) {
+	groupStore.summarize(group,summary);
+	printIocGroup(groupNum++,summary);
+    }
+}
+
+// Prints what is before the groups of a server for printIoc, or its
+// record.  Returns 1 if its groups are to be printed, else 0.
+static int printIocHeader(const char *name, const IocSummary &summary)
+{
+    if(records.getFormat() != RF_TEXT) {
+	writeIocRecord(name,summary);
+	return 0;
+    }
+
+    output.putChar('\n');
+    output.put(name);
+    output.putChar('\n');
     if(verbose) {
-	double delTime1=pIoc->getLastTime()-pIoc->getFirstTime();
-	pIoc->getFirstTime().strftime(timeStampStr1,20,"%b %d %H:%M:%S");
-	pIoc->getLastTime().strftime(timeStampStr2,20,"%b %d %H:%M:%S");
-	printf(" %s to %s (%.2f sec = %.2f min = %.2f hours)\n",
-	  timeStampStr1,timeStampStr2,delTime1,delTime1/60.,delTime1/3600.);
+	output.putChar(' ');
+	printTimeSpan(summary.firstTime,summary.lastTime);
+	if(summary.nIntervals) {
+	    printQuantiles(" Intervals: ",summary.p50,summary.p90,
+	      summary.p99);
+	}
     }
     
-    const tsDLList<CGroup> *pGroupList=pIoc->getGroupList();
-    printf(" %u group(s) of beacon anomalies\n",pGroupList->count());
-    
-    tsDLIterBD<CGroup> iter2(pGroupList->first());
-    tsDLIterBD<CGroup> eol;
-    int group=1;
-    while(iter2 != eol) {
-	CGroup *pGroup=iter2;
-	int nPoints=pGroup->getNPoints();
-	printf(" Group %d: %d event(s)",group++,pGroup->getNPoints());
-	int outOfOrder=pGroup->getOutOfOrder();
-	if(outOfOrder) {
-	    printf(" (%d event(s) out of order)\n",outOfOrder);
-	} else {
-	    printf("\n");
-	}
-	if(terse) {
-	    Characterization chn=characterize(pGroup);
-	    pGroup->getFirstTime().strftime(timeStampStr1,20,
-	      "%b %d %H:%M:%S");
-	    printf("  %s %s\n",timeStampStr1,chnString[chn]);
-	} else if(!verbose) {
-	    Characterization chn=characterize(pGroup);
-	    pGroup->getFirstTime().strftime(timeStampStr1,20,
-	      "%b %d %H:%M:%S");
-	    printf("  %s %s\n",timeStampStr1,chnString[chn]);
-	} else {
-	    if(nPoints == 1) {
-		Characterization chn=characterize(pGroup);
-		printf("  %s\n",chnString[chn]);
-		pGroup->getFirstTime().strftime(timeStampStr1,20,
-		  "%b %d %H:%M:%S");
-		printf("  %s\n",timeStampStr1);
-	    } else if(nPoints > 1) {
-		Characterization chn=characterize(pGroup);
-		printf("  %s\n",chnString[chn]);
-		double delTime2=pGroup->getLastTime()-pGroup->getFirstTime();
-		pGroup->getFirstTime().strftime(timeStampStr1,20,
-		  "%b %d %H:%M:%S");
-		pGroup->getLastTime().strftime(timeStampStr2,20,
-		  "%b %d %H:%M:%S");
-		printf("  %s to %s (%.2f sec = %.2f min = %.2f hours)\n",
-		  timeStampStr1,timeStampStr2,
-		  delTime2,delTime2/60.,delTime2/3600.);
-		
-		printf("  Mean=%.2f Sigma=%.2f Min=%.2f Max=%.2f Increasing=%d",
-		  pGroup->getMean(),pGroup->getSigma(),
-		  pGroup->getMin(),pGroup->getMax(),pGroup->getIncreasing());
-		if(pGroup->getIntervalType() == MonotonicIncreasing) {
-		    printf(" Monotonically increasing\n");
-		} else if(pGroup->getIntervalType() == MonotonicIncreasing) {
-		    printf(" Monotonically decreasing\n");
-		} else {
-		    printf("\n");
-		}
-	    }
+    output.putChar(' ');
+    output.putInt(summary.nGroups);
+    output.put(" group(s) of beacon anomalies\n");
+
+    return 1;
+}
+
+// Prints one group of a server for printIoc
+static void printIocGroup(int groupNum, const GroupSummary &summary)
+{
+    epicsTime firstTime=summary.firstTime;
+    epicsTime lastTime=summary.lastTime;
+    int nPoints=summary.nIntervals+1;
+
+    output.put(" Group ");
+    output.putInt(groupNum);
+    output.put(": ");
+    printEventCount(nPoints,summary.outOfOrder);
+    if(terse || !verbose) {
+	Characterization chn=characterize(summary);
+	output.put("  ");
+	output.putTime(firstTime);
+	output.putChar(' ');
+	output.put(chnString[chn]);
+	output.putChar('\n');
+    } else {
+	if(nPoints == 1) {
+	    Characterization chn=characterize(summary);
+	    output.put("  ");
+	    output.put(chnString[chn]);
+	    output.put("\n  ");
+	    output.putTime(firstTime);
+	    output.putChar('\n');
+	} else if(nPoints > 1) {
+	    Characterization chn=characterize(summary);
+	    output.put("  ");
+	    output.put(chnString[chn]);
+	    output.put("\n  ");
+	    printTimeSpan(firstTime,lastTime);
+	    output.put("  ");
+	    printStatistics(summary);
+	    printQuantiles("  ",summary.p50,summary.p90,summary.p99);
 	}
-	iter2++;
+    }
+}
+
+// Prints the number of events and how many were out of order, if any,
+// and ends the line
+static void printEventCount(int nPoints, int outOfOrder)
+{
+    output.putInt(nPoints);
+    output.put(" event(s)");
+    if(outOfOrder) {
+	output.put(" (");
+	output.putInt(outOfOrder);
+	output.put(" event(s) out of order)");
+    }
+    output.putChar('\n');
+}
+
+// Prints the first and last times and the time between them, and ends
+// the line
+static void printTimeSpan(const epicsTime &firstTime,
+  const epicsTime &lastTime)
+{
+    double delTime=lastTime-firstTime;
+
+    output.putTime(firstTime);
+    output.put(" to ");
+    output.putTime(lastTime);
+    output.put(" (");
+    printDuration(delTime);
+    output.put(")\n");
+}
+
+// Prints a time in seconds also in minutes and hours
+static void printDuration(double delTime)
+{
+    output.putFixed(delTime,2);
+    output.put(" sec = ");
+    output.putFixed(delTime/60.,2);
+    output.put(" min = ");
+    output.putFixed(delTime/3600.,2);
+    output.put(" hours");
+}
+
+// Prints the statistics of the intervals of a group, and ends the line
+static void printStatistics(const GroupSummary &summary)
+{
+    output.put("Mean=");
+    output.putFixed(summary.mean,2);
+    output.put(" Sigma=");
+    output.putFixed(summary.sigma,2);
+    output.put(" Min=");
+    output.putFixed(summary.min,2);
+    output.put(" Max=");
+    output.putFixed(summary.max,2);
+    output.put(" Increasing=");
+    output.putInt(summary.increasing);
+    IntervalType type=(IntervalType)summary.intervalType;
+    if(type == MonotonicIncreasing) {
+	output.put(" Monotonically increasing\n");
+    } else if(type == MonotonicIncreasing) {
+	output.put(" Monotonically decreasing\n");
+    } else {
+	output.putChar('\n');
     }
 }
 
 static void sortByGroup(SortMode sortMode)
 {
-  // Get a time to difference against (epicsTime only understands
-  // differences)
+  // Get the time to check for expired groups
     epicsTime curTime=epicsTime::getCurrent();
 
   // Free any existing arrays
@@ -667,53 +1956,54 @@ static void sortByGroup(SortMode sortMode)
 	delete [] groups;
 	groups=NULL;
     }
-    if(timeDiffs) {
-	delete [] timeDiffs;
-	timeDiffs=NULL;
+    if(timeKeys) {
+	delete [] timeKeys;
+	timeKeys=NULL;
+    }
+    if(timeTies) {
+	delete [] timeTies;
+	timeTies=NULL;
     }
     if(indices) {
 	delete [] indices;
 	indices=NULL;
     }
+    if(shardIds) {
+	delete [] shardIds;
+	shardIds=NULL;
+    }
     nArray=0;
 
-  // Get the number of entries
-    CIoc *pIoc;
-    CGroup *pGroup;
+  // Get the number of entries.  The finished groups are those on the
+  // finished list after the expired ones are added, otherwise all the
+  // groups are a linear scan of each group store.
+    int group;
     int i=0;
-    resTableIter<CIoc,stringId> iter1(iocTable.firstIter());
-    while((pIoc=iter1.pointer())) {
-	const tsDLList<CGroup> *pGroupList=pIoc->getGroupList();
-	tsDLIterBD<CGroup> iter2(pGroupList->first());
-	tsDLIterBD<CGroup> eol;
-	while(iter2 != eol) {
-	    pGroup=iter2;
-	    if(sortMode == SORT_FINISHED) {
-	      // Set group to be finished if appropriate
-		pGroup->checkFinished(curTime,NEW_GROUP_TIME);
-	      // Only do finished groups
-		if(!pGroup->isFinished()) {
-		    iter2++;
-		    continue;
-		}
-	    }
-	    i++;
-	    iter2++;
+    for(int s=0; s < nShards; s++) {
+	CGroupStore &groupStore=shards[s]->getGroupStore();
+	if(sortMode == SORT_FINISHED) {
+	    groupStore.expire(curTime,NEW_GROUP_TIME);
+	    nArray+=groupStore.getFinishedCount();
+	} else {
+	    nArray+=groupStore.count()+shards[s]->getSummaryStore().count();
 	}
-	iter1++;
     }
-    nArray=i;
 
   // Allocate arrays
     if(!nArray) return;
-    groups=new CGroup *[nArray];
+    groups=new int[nArray];
     if(!groups) {
 	errMsg("Cannot allocate space for groups array");
 	exit(1);
     }
-    timeDiffs=new double[nArray];
-    if(!timeDiffs) {
-	errMsg("Cannot allocate space for timeDiffs array");
+    timeKeys=new long long[nArray];
+    if(!timeKeys) {
+	errMsg("Cannot allocate space for timeKeys array");
+	exit(1);
+    }
+    timeTies=new int[nArray];
+    if(!timeTies) {
+	errMsg("Cannot allocate space for timeTies array");
 	exit(1);
     }
     indices=new int[nArray];
@@ -721,153 +2011,414 @@ static void sortByGroup(SortMode sortMode)
 	errMsg("Cannot allocate space for indices array");
 	exit(1);
     }
+    shardIds=new int[nArray];
+    if(!shardIds) {
+	errMsg("Cannot allocate space for shardIds array");
+	exit(1);
+    }
 
-  // Fill in arrays
-  // Loop over the iocTable
-    iter1=iocTable.firstIter();
+  // Fill in arrays for each shard in turn
     i=0;
-    while((pIoc=iter1.pointer())) {
-	const tsDLList<CGroup> *pGroupList=pIoc->getGroupList();
-	tsDLIterBD<CGroup> iter2(pGroupList->first());
-	tsDLIterBD<CGroup> eol;
-	while(iter2 != eol) {
-	    pGroup=iter2;
-	    epicsTime time;
-	    if(sortMode == SORT_FINISHED) {
-	      // Only do finished groups
-		if(!pGroup->isFinished()) {
-		    iter2++;
-		    continue;
-		}
+    for(int s=0; s < nShards; s++) {
+	CGroupStore &groupStore=shards[s]->getGroupStore();
+	CSummaryStore &summaryStore=shards[s]->getSummaryStore();
+	if(sortMode == SORT_FINISHED) {
+	    CIocTable &iocTable=shards[s]->getIocTable();
+	    for(int j=0; j < groupStore.getFinishedCount(); j++) {
+		group=groupStore.getFinished(j);
+	      // An expired group is no longer the current one
+		CIoc *pIoc=iocTable.lookup(groupStore.getIoc(group));
+		if(pIoc->getCurGroup() == group) pIoc->setCurGroup(-1);
 	      // Sort on last time in this case
-		time=pGroup->getLastTime();
-	    } else {
+		timeKeys[i]=timeKey(groupStore.getLastTime(group));
+		timeTies[i]=groupStore.getIoc(group);
+		groups[i]=group;
+		shardIds[i]=s;
+		i++;
+	    }
+	    groupStore.clearFinished();
+	} else {
+	    GroupSummary summary;
+	    summaryStore.makeIndex();
+	    for(int index=0; index < summaryStore.getSize(); index++) {
+		summaryStore.get(index,summary);
+		timeKeys[i]=timeKey(summary.firstTime);
+		timeTies[i]=summary.iocId;
+		groups[i]=~index;
+		shardIds[i]=s;
+		i++;
+	    }
+	    int size=groupStore.getSize();
+	    for(group=0; group < size; group++) {
+		if(!groupStore.isUsed(group)) continue;
 	      // Sort on first time
-		time=pGroup->getFirstTime();
+		timeKeys[i]=timeKey(groupStore.getFirstTime(group));
+		timeTies[i]=groupStore.getIoc(group);
+		groups[i]=group;
+		shardIds[i]=s;
+		i++;
 	    }
-	    timeDiffs[i]=time-curTime;
-	    indices[i]=i;
-	    groups[i]=pGroup;
-	    i++;
-	    iter2++;
 	}
-        iter1++;
     }
 
-  // Sort
-    hsort(timeDiffs,indices,nArray);
+  // Sort.  The groups of each shard are nearly in time order already,
+  // since the ids are in the order they were made, so msort merges a
+  // few long runs from each shard.  Groups with the same time are put
+  // in the order of their server ids, since the group ids are in a
+  // different order with -jobs or -shards.
+    msort(timeKeys,timeTies,indices,nArray);
 
     return;
 }
 
 static void reportByGroup()
 {
-    CGroup *pGroup;
-    int i,index;
+    GroupSummary summary;
+    int i,index,group;
 
     for(i=0; i < nArray; i++) {
 	index=indices[i];
-	pGroup=groups[index];
-	printGroup(pGroup);
+	group=groups[index];
+	CShard &shard=*shards[shardIds[index]];
+	if(group < 0) shard.getSummaryStore().get(~group,summary);
+	else shard.getGroupStore().summarize(group,summary);
+	printGroup(shard.getIocTable().lookup(summary.iocId)->getName(),
+	  summary);
     }
 }
 
 void removeFinished(void)
 {
     CIoc *pIoc;
-    CGroup *pGroup;
-    int i,index;
+    int i,index,group;
 
     for(i=0; i < nArray; i++) {
 	index=indices[i];
-	pGroup=groups[index];
-	pIoc=&pGroup->getIoc();
+	group=groups[index];
+	CShard &shard=*shards[shardIds[index]];
+	CIocTable &iocTable=shard.getIocTable();
+	pIoc=iocTable.lookup(shard.getGroupStore().getIoc(group));
 #if DEBUG_REALTIME
-	printf(" Removing group: %s groupCount=%d\n",pIoc->resourceName(),
-	  pIoc->getGroupList()->count());
+	printf(" Removing group: %s groupCount=%u\n",pIoc->getName(),
+	  pIoc->getGroupCount());
 #endif
-      // Deleting the group should remove it from the groupList
-	delete pGroup;
-      // Set the current group in the ioc to NULL
-	pIoc->setCurGroup(NULL);
+      // This also sets the current group in the ioc to none if it is
+      // this one
+	pIoc->removeGroup(group);
       // If the group list in the ioc is empty, remove the ioc
-	int count=pIoc->getGroupList()->count();
-	if(count <= 0) {
+	if(pIoc->getGroupCount() <= 0) {
 #if DEBUG_REALTIME
-	    printf(" Removing ioc: %s groupCount=%d\n",pIoc->resourceName(),
-	      pIoc->getGroupList()->count());
+	    printf(" Removing ioc: %s groupCount=%u\n",pIoc->getName(),
+	      pIoc->getGroupCount());
 #endif
 	    iocTable.remove(*pIoc);
-	    delete pIoc;
+	    CIoc::destroy(pIoc);
+	}
+    }
+}
+
+// Prints the percentiles of the intervals after an indent
+static void printQuantiles(const char *indent, double p50, double p90,
+  double p99)
+{
+    output.put(indent);
+    output.put("P50=");
+    output.putFixed(p50,2);
+    output.put(" P90=");
+    output.putFixed(p90,2);
+    output.put(" P99=");
+    output.putFixed(p99,2);
+    output.putChar('\n');
+}
+
+// Prints the usage of the server pool, the sketch pool, and the group
+// store of each shard.  In real-time mode the high-water marks show the
+// most memory the groups have needed, and the event rings show how far
+// the workers have been behind the input.  The usage of the pools and
+// stores is the one in the snapshot if there is one, since the shards
+// are running.
+static void printPoolStats(const CSnapshot *pSnapshot)
+{
+    fprintf(infoFile,"\n");
+    for(int i=0; i < nShards; i++) {
+	if(nShards > 1) fprintf(infoFile,"Shard %d:\n",i);
+	if(pSnapshot) {
+	    fputs(pSnapshot->getStats(i),infoFile);
+	    shards[i]->getRing().printStats(infoFile);
+	} else {
+	    shards[i]->printStats(infoFile);
 	}
     }
 }
 
-static void printGroup(CGroup *pGroup)
+// Pauses the shard workers so the shards can be used by this thread
+static void pauseShards(void)
+{
+    for(int i=0; i < nShards; i++) shards[i]->pause();
+}
+
+static void resumeShards(void)
 {
-    char timeStampStr1[16];
-    char timeStampStr2[16];
+    for(int i=0; i < nShards; i++) shards[i]->resume();
+}
+
+static void printGroup(const char *name, const GroupSummary &summary)
+{
+    epicsTime firstTime=summary.firstTime;
+    epicsTime lastTime=summary.lastTime;
     
-    pGroup->getFirstTime().strftime(timeStampStr1,20,"%b %d %H:%M:%S");
-    pGroup->getLastTime().strftime(timeStampStr2,20,"%b %d %H:%M:%S");
-    double delTime1=pGroup->getLastTime()-pGroup->getFirstTime();
-    Characterization chn=characterize(pGroup);
-    int nPoints=pGroup->getNPoints();
+    if(records.getFormat() != RF_TEXT) {
+	writeGroupRecord(name,summary);
+	return;
+    }
+
+    Characterization chn=characterize(summary);
+    int nPoints=summary.nIntervals+1;
     if(terse) {
-	printf("%s %s %s\n",pGroup->getIoc().resourceName(),
-	  timeStampStr1,chnString[chn]);
+	output.put(name);
+	output.putChar(' ');
+	output.putTime(firstTime);
+	output.putChar(' ');
+	output.put(chnString[chn]);
+	output.putChar('\n');
     } else if(!verbose) {
-	printf("\n%s\n",pGroup->getIoc().resourceName());
-	printf(" %s\n",chnString[chn]);
+	output.putChar('\n');
+	output.put(name);
+	output.put("\n ");
+	output.put(chnString[chn]);
+	output.put("\n ");
+	output.putTime(firstTime);
+	output.putChar(' ');
+	output.putInt(nPoints);
 	if(nPoints == 1) {
-	    printf(" %s %d event(s)\n",
-	      timeStampStr1,pGroup->getNPoints());
+	    output.put(" event(s)\n");
 	} else if (nPoints > 1) {
-	    printf(" %s %d event(s) for %.2f sec = %.2f min = %.2f hours\n",
-	      timeStampStr1,pGroup->getNPoints(),
-	      delTime1,delTime1/60.,delTime1/3600.);
+	    output.put(" event(s) for ");
+	    printDuration(lastTime-firstTime);
+	    output.putChar('\n');
+	}
+    } else {
+	output.putChar('\n');
+	output.put(name);
+	output.put("\n ");
+	output.put(chnString[chn]);
+	output.put("\n ");
+	printEventCount(nPoints,summary.outOfOrder);
+	output.putChar(' ');
+	printTimeSpan(firstTime,lastTime);
+	if(nPoints > 1) {
+	    output.putChar(' ');
+	    printStatistics(summary);
+	    printQuantiles(" ",summary.p50,summary.p90,summary.p99);
 	}
+    }
+}
+
+// Writes the record for a group.  The times are integer nanoseconds
+// since the POSIX epoch, and the durations are integer nanoseconds, so
+// nothing is lost to rounding at the resolution of the input.  The
+// statistics are null if there is only one event.
+static void writeGroupRecord(const char *name, const GroupSummary &summary)
+{
+    records.begin(groupColumns,N_GROUP_COLUMNS);
+    records.putString(name);
+    records.putInt(unixTimeKey(summary.firstTime));
+    records.putInt(unixTimeKey(summary.lastTime));
+    records.putInt(summary.nIntervals+1);
+    records.putInt(summary.outOfOrder);
+    records.putString(chnKey[characterize(summary)]);
+    records.putString(intervalTypeKey[summary.intervalType]);
+    records.putInt(summary.increasing);
+    if(summary.nIntervals > 0) {
+	putNanoseconds(summary.mean);
+	putNanoseconds(summary.sigma);
+	putNanoseconds(summary.min);
+	putNanoseconds(summary.max);
+	putNanoseconds(summary.p50);
+	putNanoseconds(summary.p90);
+	putNanoseconds(summary.p99);
     } else {
-	printf("\n%s\n",pGroup->getIoc().resourceName());
-	printf(" %s\n",chnString[chn]);
-	printf(" %d event(s)",pGroup->getNPoints());
-	int outOfOrder=pGroup->getOutOfOrder();
-	if(outOfOrder) {
-	    printf(" (%d event(s) out of order)\n",outOfOrder);
+	for(int i=0; i < 7; i++) records.putNull();
+    }
+    records.end();
+}
+
+// Writes the record for a server, with the percentiles of all its
+// intervals, which are null if it has none
+static void writeIocRecord(const char *name, const IocSummary &summary)
+{
+    records.begin(iocColumns,N_IOC_COLUMNS);
+    records.putString(name);
+    records.putInt(unixTimeKey(summary.firstTime));
+    records.putInt(unixTimeKey(summary.lastTime));
+    records.putInt(summary.nGroups);
+    records.putInt(summary.nIntervals);
+    if(summary.nIntervals) {
+	putNanoseconds(summary.p50);
+	putNanoseconds(summary.p90);
+	putNanoseconds(summary.p99);
+    } else {
+	for(int i=0; i < 3; i++) records.putNull();
+    }
+    records.end();
+}
+
+// Puts a time in seconds into the record as integer nanoseconds
+static void putNanoseconds(double sec)
+{
+    records.putInt((long long)floor(sec*1.e9+.5));
+}
+
+// Writes the servers and the groups in the order of the report by
+// group to the export file.  Returns P_OK or P_ERROR.
+static int exportGroups(void)
+{
+    CExportFile exportFile;
+    int nServers=iocNames.count();
+    int i,index,group;
+
+  // The servers are indexed by their ids, which are global
+    IocSummary *servers=new IocSummary[nServers+1];
+    if(!servers) {
+	errMsg("Cannot allocate space for export servers");
+	exit(1);
+    }
+    memset(servers,0,(nServers+1)*sizeof(IocSummary));
+    for(int s=0; s < nShards; s++) {
+	CIocTable &iocTable=shards[s]->getIocTable();
+	for(int id=0; id < iocTable.getSize(); id++) {
+	    CIoc *pIoc=iocTable.lookup(id);
+	    if(pIoc) pIoc->summarize(servers[id]);
+	}
+    }
+
+    sortByGroup(SORT_GROUP);
+    GroupSummary *summaries=new GroupSummary[nArray+1];
+    if(!summaries) {
+	errMsg("Cannot allocate space for export groups");
+	exit(1);
+    }
+    unsigned char *chns=new unsigned char[nArray+1];
+    if(!chns) {
+	errMsg("Cannot allocate space for export characterizations");
+	exit(1);
+    }
+    for(i=0; i < nArray; i++) {
+	index=indices[i];
+	group=groups[index];
+	CShard &shard=*shards[shardIds[index]];
+	if(group < 0) {
+	    shard.getSummaryStore().get(~group,summaries[i]);
 	} else {
-	    printf("\n");
+	    shard.getGroupStore().summarize(group,summaries[i]);
 	}
-	pGroup->getLastTime().strftime(timeStampStr2,20,"%b %d %H:%M:%S");
-	printf(" %s to %s (%.2f sec = %.2f min = %.2f hours)\n",
-	  timeStampStr1,timeStampStr2,delTime1,delTime1/60.,delTime1/3600.);
-	if(nPoints == 1) {
-	    pGroup->getFirstTime().strftime(timeStampStr1,20,
-	      "%b %d %H:%M:%S");
-	} else if(nPoints > 1) {
-	    printf(" Mean=%.2f Sigma=%.2f Min=%.2f Max=%.2f Increasing=%d",
-	      pGroup->getMean(),pGroup->getSigma(),
-	      pGroup->getMin(),pGroup->getMax(),pGroup->getIncreasing());
-	    if(pGroup->getIntervalType() == MonotonicIncreasing) {
-		printf(" Monotonically increasing\n");
-	    } else if(pGroup->getIntervalType() == MonotonicIncreasing) {
-		printf(" Monotonically decreasing\n");
-	    } else {
-		printf("\n");
-	    }
+	chns[i]=(unsigned char)characterize(summaries[i]);
+    }
+
+    int status=exportFile.write(exportFileName,iocNames,servers,nArray,
+      summaries,chns);
+    if(status == P_OK) {
+	fprintf(infoFile,"Exported %d groups of %d servers to %s\n",
+	  nArray,nServers,exportFileName);
+    } else {
+	errMsg("Cannot write %s:\n%s\n",exportFileName,
+	  exportFile.getErrorString());
+    }
+
+    delete [] chns;
+    delete [] summaries;
+    delete [] servers;
+
+    return status;
+}
+
+// Prints the report from the export file.  The groups are in the order
+// of the report by group, and for the report by server they are linked
+// to their servers in that order, which is the time order of each
+// server.  Returns P_OK or P_ERROR.
+static int reportImport(void)
+{
+    CExportFile importFile;
+    IocSummary iocSummary;
+    GroupSummary summary;
+    int i,index,group;
+
+    if(importFile.open(importFileName) != P_OK) {
+	errMsg("Cannot read %s:\n%s\n",importFileName,
+	  importFile.getErrorString());
+	return P_ERROR;
+    }
+    int nServers=importFile.getServerCount();
+    int nGroups=importFile.getGroupCount();
+
+    fflush(stdout);
+    if(defaultSortMode == SORT_GROUP) {
+	for(i=0; i < nGroups; i++) {
+	    importFile.getGroup(i,summary);
+	    printGroup(importFile.getName(summary.iocId),summary);
 	}
+	output.flush();
+	return P_OK;
+    }
+
+  // Link the groups of each server, and sort the servers with groups
+  // by their first times, with ties in id order
+    int *firstGroups=new int[nServers+1];
+    int *nextGroups=new int[nGroups+1];
+    long long *keys=new long long[nServers+1];
+    int *ties=new int[nServers+1];
+    int *indx=new int[nServers+1];
+    if(!firstGroups || !nextGroups || !keys || !ties || !indx) {
+	errMsg("Cannot allocate space for import arrays");
+	exit(1);
     }
+    for(i=0; i < nServers; i++) firstGroups[i]=-1;
+    for(group=nGroups-1; group >= 0; group--) {
+	int server=importFile.getServer(group);
+	nextGroups[group]=firstGroups[server];
+	firstGroups[server]=group;
+    }
+    int n=0;
+    for(i=0; i < nServers; i++) {
+	if(firstGroups[i] < 0) continue;
+	importFile.getIoc(i,iocSummary);
+	keys[n]=timeKey(iocSummary.firstTime);
+	ties[n]=i;
+	n++;
+    }
+    msort(keys,ties,indx,n);
+
+    for(i=0; i < n; i++) {
+	index=ties[indx[i]];
+	importFile.getIoc(index,iocSummary);
+	if(!printIocHeader(importFile.getName(index),iocSummary)) continue;
+	int groupNum=1;
+	for(group=firstGroups[index]; group >= 0; group=nextGroups[group]) {
+	    importFile.getGroup(group,summary);
+	    printIocGroup(groupNum++,summary);
+	}
+    }
+    output.flush();
+
+    delete [] indx;
+    delete [] ties;
+    delete [] keys;
+    delete [] nextGroups;
+    delete [] firstGroups;
+
+    return P_OK;
 }
 
-static Characterization characterize(CGroup *pGroup)
+static Characterization characterize(const GroupSummary &summary)
 {
-    double max=pGroup->getMax();
-    double min=pGroup->getMin();
-    int nPoints=pGroup->getNPoints();
-    int nIntervals=pGroup->getNIntervals();
-    int outOfOrder=pGroup->getOutOfOrder();
-    int increasing=pGroup->getIncreasing();
+    double max=summary.max;
+    double min=summary.min;
+    int nPoints=summary.nIntervals+1;
+    int nIntervals=summary.nIntervals;
+    int outOfOrder=summary.outOfOrder;
+    int increasing=summary.increasing;
     int nonIncreasing=nIntervals-increasing;
-    IntervalType type=pGroup->getIntervalType();
+    IntervalType type=(IntervalType)summary.intervalType;
 
     if(nPoints == 1) {
 	return CHN_SINGLE;
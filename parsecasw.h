@@ -3,8 +3,6 @@
 #ifndef _INC_PARSECASW_H
 #define _INC_PARSECASW_H
 
-#define READ_LINESIZE 512
-
 #define P_OK 0
 #define P_ERROR 1
 
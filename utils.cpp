@@ -1,68 +1,233 @@
 // Implementation for utils
 
-// The following must be 1024 or less for WIN32
-#define FIXED_MSG_SIZE 1024
-
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "utils.h"
 
+// Where errMsg prints, which is stdout unless setErrFile is called
+static FILE *errFile=NULL;
+
+// Prints a message to stdout, or the file from setErrFile.  It is
+// formatted by vfprintf in one call, so it has no length limit, a % in
+// an argument is printed as is, and it is not split by output from
+// other threads.
 int errMsg(const char *fmt, ...)
 {
     va_list vargs;
-    static char lstring[FIXED_MSG_SIZE];
 
     va_start(vargs,fmt);
-    (void)vsprintf(lstring,fmt,vargs);
+    (void)vfprintf(errFile?errFile:stdout,fmt,vargs);
     va_end(vargs);
-    
-    if(lstring[0] != '\0') {
-	fprintf(stdout,lstring);
-    }
 
     return 0;
 }
 
-// Heap sort routine: Sorts an array of length n into ascending order
-// and puts the sorted indices in indx.
-void hsort(double array[], int indx[], int n)
+// Sets where errMsg prints, so the messages can be kept out of stdout
+// when it has the records
+void setErrFile(FILE *fp)
+{
+    errFile=fp;
+}
+
+// Returns 1 if element a comes before element b
+static inline int sortBefore(const long long keys[], const int ties[],
+  int a, int b)
 {
-    int l,j,ir,indxt,i;
-    double q;
+    if(keys[a] != keys[b]) return keys[a] < keys[b];
+    if(ties && ties[a] != ties[b]) return ties[a] < ties[b];
+    return a < b;
+}
+
+// Natural merge sort routine: Puts in indx the indices of the n keys in
+// ascending order.  Equal keys are in ascending order of ties, or of
+// their index if ties is NULL.  The ascending runs already in the keys
+// are found first and only they are merged, so keys that are nearly in
+// order, such as times in the order they were made, take close to
+// linear time.
+void msort(const long long keys[], const int ties[], int indx[], int n)
+{
+    int *runs,*tmp,*src,*dst;
+    int nRuns,i,j;
+
+    for(i=0; i < n; i++) indx[i]=i;
+    if(n < 2) return;
 
-  /* All done if none or one element */
-    if(n == 0) return;
-    if(n == 1) {
-	indx[0]=0;
+  // Find the runs.  runs[i] is the start of run i, and runs[nRuns] is n.
+    runs=new int[n+1];
+    if(!runs) {
+	errMsg("Cannot allocate space for sort runs array");
+	exit(1);
+    }
+    nRuns=0;
+    runs[nRuns++]=0;
+    for(i=1; i < n; i++) {
+	if(sortBefore(keys,ties,i,i-1)) runs[nRuns++]=i;
+    }
+    runs[nRuns]=n;
+    if(nRuns == 1) {
+	delete [] runs;
 	return;
     }
-    
-  /* Initialize indx array */
-    for(j=0; j < n; j++) indx[j]=j;
-  /* Loop over elements */
-    l=(n>>1);
-    ir=n-1;
-    for(;;) {
-	if(l > 0) q=array[(indxt=indx[--l])];
-	else {
-	    q=array[(indxt=indx[ir])];
-	    indx[ir]=indx[0];
-	    if(--ir == 0) {
-		indx[0]=indxt;
-		return;
-	    }
-	}
-	i=l;
-	j=(l<<1)+1;
-	while(j <= ir) {
-	    if(j < ir && array[indx[j]] < array[indx[j+1]]) j++;
-	    if(q < array[indx[j]]) {
-		indx[i]=indx[j];
-		j+=((i=j)+1);
-		
+
+  // Merge pairs of runs until there is one
+    tmp=new int[n];
+    if(!tmp) {
+	errMsg("Cannot allocate space for sort array");
+	exit(1);
+    }
+    src=indx;
+    dst=tmp;
+    while(nRuns > 1) {
+	int nNew=0;
+	for(j=0; j < nRuns; j+=2) {
+	    int start=runs[j];
+	    int mid=(j+1 < nRuns)?runs[j+1]:n;
+	    int end=(j+2 < nRuns)?runs[j+2]:n;
+	    int k=start,l=mid,m=start;
+	    while(k < mid && l < end) {
+		if(sortBefore(keys,ties,src[l],src[k])) dst[m++]=src[l++];
+		else dst[m++]=src[k++];
 	    }
-	    else break;
+	    while(k < mid) dst[m++]=src[k++];
+	    while(l < end) dst[m++]=src[l++];
+	    runs[nNew++]=start;
 	}
-	indx[i]=indxt;
+	runs[nNew]=n;
+	nRuns=nNew;
+	int *swap=src;
+	src=dst;
+	dst=swap;
+    }
+    if(src != indx) {
+	for(i=0; i < n; i++) indx[i]=src[i];
+    }
+
+    delete [] tmp;
+    delete [] runs;
+}
+
+// Gets the size and modification time of a file, which show whether a
+// file made from it is out of date.  Returns 0, or -1 if it cannot.
+int getFileStamp(const char *fileName, long long *size, long long *mtime)
+{
+    struct stat statBuf;
+
+    if(stat(fileName,&statBuf)) return -1;
+    *size=(long long)statBuf.st_size;
+    *mtime=(long long)statBuf.st_mtime;
+    return 0;
+}
+
+// Fills in the header of a binary file
+void initFileHeader(FileHeader &header, const char *magic,
+  epicsUInt32 version)
+{
+    memset(&header,0,sizeof(header));
+    strncpy(header.magic,magic,sizeof(header.magic));
+    header.byteOrder=FILE_BYTE_ORDER;
+    header.version=version;
+}
+
+// Checks the header of a binary file.  Returns NULL if it is a file of
+// this kind and version that can be read here, else why not.
+const char *checkFileHeader(const FileHeader &header, const char *magic,
+  epicsUInt32 version)
+{
+    if(strncmp(header.magic,magic,sizeof(header.magic))) {
+	return "It is not a file of this kind";
+    }
+    if(header.byteOrder != FILE_BYTE_ORDER) {
+	return "It has a different byte order";
+    }
+    if(header.version != version) return "It is an unsupported version";
+    return NULL;
+}
+
+// Returns a hash of the local time zone, from TZ and the names and
+// offset the C library has for it
+static epicsUInt32 getTimeZoneHash(void)
+{
+    char zone[128];
+    const char *tz=getenv("TZ");
+    epicsUInt32 hash=2166136261u;
+
+#ifdef WIN32
+    _tzset();
+    sprintf(zone,"%.64s %.16s %.16s %ld",tz?tz:"",_tzname[0],_tzname[1],
+      (long)_timezone);
+#else
+    tzset();
+    sprintf(zone,"%.64s %.16s %.16s %ld",tz?tz:"",tzname[0],tzname[1],
+      (long)timezone);
+#endif
+    for(const char *p=zone; *p; p++) {
+	hash^=(unsigned char)*p;
+	hash*=16777619u;
+    }
+    return hash;
+}
+
+// Returns the options of a file made from an input file, which are
+// what change the times that are parsed from the input.  The times
+// are local times, so the high bits are a hash of the time zone, and a
+// cache or index made in another zone is not used.
+epicsUInt32 makeStampedOptions(int fileType, int utc)
+{
+    epicsUInt32 zoneHash=getTimeZoneHash();
+
+    return (epicsUInt32)fileType | (utc?0x100u:0u) |
+      ((zoneHash ^ (zoneHash >> 16)) << 16);
+}
+
+// Makes the name of a file made from an input file by appending the
+// suffix.  Returns 0, or -1 if it does not fit in size.
+int makeStampedName(const char *inputName, const char *suffix,
+  char *name, size_t size)
+{
+    if(strlen(inputName)+strlen(suffix) >= size) return -1;
+    strcpy(name,inputName);
+    strcat(name,suffix);
+    return 0;
+}
+
+// Fills in the header of a file made from an input file with the size
+// and modification time of the input.  Returns 0, or -1 if they cannot
+// be got.
+int initStampedHeader(StampedHeader &header, const char *magic,
+  epicsUInt32 version, const char *inputName, epicsUInt32 options)
+{
+    long long size,mtime;
+
+    memset(&header,0,sizeof(header));
+    if(getFileStamp(inputName,&size,&mtime)) return -1;
+    initFileHeader(header.file,magic,version);
+    header.inputSize=(epicsUInt64)size;
+    header.inputMtime=(epicsInt64)mtime;
+    header.options=options;
+    return 0;
+}
+
+// Checks the header of a file made from an input file.  Returns NULL if
+// it is up to date and was made with the same options, else why not.
+const char *checkStampedHeader(const StampedHeader &header,
+  const char *magic, epicsUInt32 version, const char *inputName,
+  epicsUInt32 options)
+{
+    long long size,mtime;
+
+    const char *error=checkFileHeader(header.file,magic,version);
+    if(error) return error;
+    if(getFileStamp(inputName,&size,&mtime) ||
+      (epicsUInt64)size != header.inputSize ||
+      (epicsInt64)mtime != header.inputMtime) {
+	return "It is out of date";
     }
+    if(header.options != options) return "It was made with other options";
+    return NULL;
 }
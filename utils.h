@@ -3,9 +3,64 @@
 #ifndef _INCLUDE_UTILS_H
 #define _INCLUDE_UTILS_H
 
+#include <stdio.h>
+#include <stddef.h>
+
+#include <epicsTypes.h>
+#include <epicsTime.h>
+
+// The binary files are written in the byte order of the machine, which
+// the reader must share, and start with a FileHeader
+#define FILE_BYTE_ORDER 0x01020304
+
+struct FileHeader
+{
+    char magic[8];
+    epicsUInt32 byteOrder;
+    epicsUInt32 version;
+};
+
+// The start of the header of a file that is made from an input file,
+// such as an index or a cache.  It is only used while the input has
+// the same size and modification time and the options match.
+struct StampedHeader
+{
+    FileHeader file;
+    epicsUInt64 inputSize;
+    epicsInt64 inputMtime;
+    epicsUInt32 options;
+};
+
+// Returns a time in integer nanoseconds since the EPICS epoch, as the
+// times are kept in the binary files
+static inline epicsInt64 timeToNs(const epicsTimeStamp &stamp)
+{
+    return (epicsInt64)stamp.secPastEpoch*1000000000LL+stamp.nsec;
+}
+
+static inline void nsToTime(epicsInt64 ns, epicsTimeStamp &stamp)
+{
+    stamp.secPastEpoch=(epicsUInt32)(ns/1000000000LL);
+    stamp.nsec=(epicsUInt32)(ns%1000000000LL);
+}
+
 // Function prototypes
 
 int errMsg(const char *fmt, ...);
-void hsort(double array[], int indx[], int n);
+void setErrFile(FILE *fp);
+void msort(const long long keys[], const int ties[], int indx[], int n);
+int getFileStamp(const char *fileName, long long *size, long long *mtime);
+void initFileHeader(FileHeader &header, const char *magic,
+  epicsUInt32 version);
+const char *checkFileHeader(const FileHeader &header, const char *magic,
+  epicsUInt32 version);
+epicsUInt32 makeStampedOptions(int fileType, int utc);
+int makeStampedName(const char *inputName, const char *suffix,
+  char *name, size_t size);
+int initStampedHeader(StampedHeader &header, const char *magic,
+  epicsUInt32 version, const char *inputName, epicsUInt32 options);
+const char *checkStampedHeader(const StampedHeader &header,
+  const char *magic, epicsUInt32 version, const char *inputName,
+  epicsUInt32 options);
 
 #endif     // #ifndef _INCLUDE_UTILS_H